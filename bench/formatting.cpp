@@ -0,0 +1,187 @@
+// Micro-benchmark das funções de formatting.hpp, comparando com as versões
+// baseadas em std::regex que eram usadas antes. Também confere que as duas
+// implementações produzem exatamente o mesmo resultado para cada entrada.
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "../src/formatting.hpp"
+
+namespace legacy {
+
+void formatPhoneNumber(char* numero) {
+  std::string clean_phone = std::regex_replace(numero, std::regex("\\D+"), "");
+
+  if (clean_phone.length() < 10 || clean_phone.length() > 11) {
+    numero[0] = 0;
+
+    return;
+  }
+
+  std::string new_phone;
+  if (clean_phone.length() == 10) {
+    new_phone = std::regex_replace(
+        clean_phone, std::regex("(\\d{2})(\\d{4})(\\d{4})"), "($1) $2-$3");
+  } else {
+    new_phone = std::regex_replace(
+        clean_phone, std::regex("(\\d{2})(\\d{5})(\\d{4})"), "($1) $2-$3");
+  }
+
+  memcpy(numero, new_phone.c_str(), new_phone.length() + 1);
+}
+
+void formatDate(char* data) {
+  std::string dataLimpa = std::regex_replace(data, std::regex("\\D+"), "");
+
+  if (dataLimpa.length() != 8) {
+    data[0] = 0;
+
+    return;
+  }
+
+  snprintf(data, 11, "%s/%s/%s", dataLimpa.substr(0, 2).c_str(),
+           dataLimpa.substr(2, 2).c_str(), dataLimpa.substr(4).c_str());
+}
+
+bool validatePhone(const char* phone) {
+  std::regex reg("\\(\\d{2}\\)\\s\\d{5}-\\d{4}");
+
+  return std::regex_match(phone, reg);
+}
+
+bool validateDate(const char* date) {
+  std::regex reg("\\d{2}/\\d{2}/\\d{4}");
+
+  return std::regex_match(date, reg);
+}
+
+}  // namespace legacy
+
+// Gera entradas parecidas com o que é digitado no formulário: dígitos
+// misturados com os caracteres aceitos pelos filtros de texto
+std::vector<std::string> generateInputs(const char* alfabeto, int quantidade) {
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<int> tamanho(0, 15);
+  std::uniform_int_distribution<int> letra(0, (int)strlen(alfabeto) - 1);
+
+  std::vector<std::string> entradas;
+  entradas.reserve(quantidade);
+
+  for (int i = 0; i < quantidade; i++) {
+    std::string entrada;
+    for (int n = tamanho(rng); n > 0; n--) entrada += alfabeto[letra(rng)];
+
+    entradas.push_back(entrada);
+  }
+
+  return entradas;
+}
+
+template <typename Fn>
+double measure(const std::vector<std::string>& entradas, Fn fn) {
+  auto inicio = std::chrono::steady_clock::now();
+  for (const auto& entrada : entradas) fn(entrada.c_str());
+  auto fim = std::chrono::steady_clock::now();
+
+  return std::chrono::duration<double, std::nano>(fim - inicio).count() /
+         entradas.size();
+}
+
+int main(int argc, char const* argv[]) {
+  const int quantidade = argc > 1 ? atoi(argv[1]) : 100000;
+  int divergencias = 0;
+
+  auto telefones = generateInputs("0123456789012345678901234567890() -",
+                                  quantidade);
+  telefones.push_back("(11) 98765-4321");
+  telefones.push_back("(11)\t98765-4321");
+  telefones.push_back("11 3333-4444");
+
+  auto datas = generateInputs("01234567890123456789/", quantidade);
+  datas.push_back("05/12/2023");
+  datas.push_back("5/12/2023");
+
+  // Os buffers do formulário têm 16 bytes
+  auto format = [](void (*fn)(char*), const char* entrada, char* buffer) {
+    const size_t tamanho = strnlen(entrada, 15);
+    memcpy(buffer, entrada, tamanho);
+    buffer[tamanho] = 0;
+    fn(buffer);
+  };
+
+  for (const auto& telefone : telefones) {
+    char novo[16], antigo[16];
+    format(formatPhoneNumber, telefone.c_str(), novo);
+    format(legacy::formatPhoneNumber, telefone.c_str(), antigo);
+
+    if (strcmp(novo, antigo) != 0 ||
+        validatePhone(telefone.c_str()) !=
+            legacy::validatePhone(telefone.c_str()) ||
+        validatePhone(novo) != legacy::validatePhone(novo)) {
+      fprintf(stderr, "divergência no telefone \"%s\"\n", telefone.c_str());
+      divergencias++;
+    }
+  }
+
+  for (const auto& data : datas) {
+    char novo[16], antigo[16];
+    format(formatDate, data.c_str(), novo);
+    format(legacy::formatDate, data.c_str(), antigo);
+
+    if (strcmp(novo, antigo) != 0 ||
+        validateDate(data.c_str()) != legacy::validateDate(data.c_str()) ||
+        validateDate(novo) != legacy::validateDate(novo)) {
+      fprintf(stderr, "divergência na data \"%s\"\n", data.c_str());
+      divergencias++;
+    }
+  }
+
+  struct Caso {
+    const char* nome;
+    double regex_ns;
+    double novo_ns;
+  };
+
+  char buffer[16];
+  const Caso casos[] = {
+      {"formatPhoneNumber",
+       measure(telefones,
+               [&](const char* e) {
+                 format(legacy::formatPhoneNumber, e, buffer);
+               }),
+       measure(telefones,
+               [&](const char* e) { format(formatPhoneNumber, e, buffer); })},
+      {"formatDate",
+       measure(datas,
+               [&](const char* e) { format(legacy::formatDate, e, buffer); }),
+       measure(datas, [&](const char* e) { format(formatDate, e, buffer); })},
+      {"validatePhone",
+       measure(telefones,
+               [&](const char* e) { buffer[0] = legacy::validatePhone(e); }),
+       measure(telefones,
+               [&](const char* e) { buffer[0] = validatePhone(e); })},
+      {"validateDate",
+       measure(datas,
+               [&](const char* e) { buffer[0] = legacy::validateDate(e); }),
+       measure(datas, [&](const char* e) { buffer[0] = validateDate(e); })},
+  };
+
+  printf("%-18s %12s %12s %10s\n", "funcao", "regex (ns)", "novo (ns)",
+         "ganho");
+  for (const Caso& caso : casos) {
+    printf("%-18s %12.1f %12.1f %9.1fx\n", caso.nome, caso.regex_ns,
+           caso.novo_ns, caso.regex_ns / caso.novo_ns);
+  }
+
+  if (divergencias > 0) {
+    fprintf(stderr, "%d entradas com resultado diferente\n", divergencias);
+    return 1;
+  }
+
+  return 0;
+}
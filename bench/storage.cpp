@@ -0,0 +1,570 @@
+// Benchmark das consultas e escritas que o aplicativo faz no banco, sem
+// interface gráfica. Gera um banco sintético do tamanho pedido e mede cada
+// operação com o perfil de armazenamento do aplicativo e com os valores
+// padrão do SQLite. Cada medição é impressa como uma linha JSON na saída
+// padrão, para que os resultados possam ser comparados entre versões:
+//
+//   bench [--doadores N] [--doacoes N] [--doados 0.3] [--repeticoes N]
+//         [--operacoes N] [--importacao N] [--perfil app|sqlite|ambos]
+//         [--banco arquivo] [--semente N]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../src/donation_snapshot.hpp"
+#include "../src/donor_cache.hpp"
+#include "../src/importer.hpp"
+#include "../src/phone_index.hpp"
+#include "../src/queries.hpp"
+#include "../src/replication.hpp"
+#include "../src/stock_pager.hpp"
+#include "../src/storage.hpp"
+
+struct Options {
+  int doadores = 10000;
+  int doacoes = 100000;
+  double doados = 0.3;     // fração das doações com status "Doado"
+  int repeticoes = 5;      // execuções de cada consulta de leitura
+  int operacoes = 1000;    // escritas medidas uma a uma
+  int importacao = 50000;  // linhas do CSV importado
+  std::string perfil = "ambos";
+  std::string banco = "bench.sqlite";
+  unsigned semente = 42;
+};
+
+using Clock = std::chrono::steady_clock;
+
+double elapsedMs(Clock::time_point inicio) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - inicio)
+      .count();
+}
+
+// Imprime uma medição como uma linha JSON. itens é quantas linhas ou
+// operações cada amostra processou
+void report(const Options& options, const char* perfil, const char* nome,
+            std::vector<double> tempos, size_t itens) {
+  std::sort(tempos.begin(), tempos.end());
+
+  double total = 0;
+  for (double tempo : tempos) total += tempo;
+
+  const size_t n = tempos.size();
+  printf(
+      "{\"bench\":\"%s\",\"perfil\":\"%s\",\"doadores\":%d,\"doacoes\":%d,"
+      "\"doados\":%.2f,\"amostras\":%zu,\"itens\":%zu,\"media_ms\":%.4f,"
+      "\"p50_ms\":%.4f,\"p95_ms\":%.4f,\"min_ms\":%.4f,\"max_ms\":%.4f}\n",
+      nome, perfil, options.doadores, options.doacoes, options.doados, n,
+      itens, total / n, tempos[n / 2], tempos[std::min(n - 1, n * 95 / 100)],
+      tempos.front(), tempos.back());
+  fflush(stdout);
+}
+
+// Executa fn repeticoes vezes, medindo cada execução. fn devolve quantos
+// itens processou
+template <typename Fn>
+void measure(const Options& options, const char* perfil, const char* nome,
+             int repeticoes, Fn&& fn) {
+  std::vector<double> tempos;
+  size_t itens = 0;
+
+  for (int i = 0; i < repeticoes; i++) {
+    const auto inicio = Clock::now();
+    itens = fn();
+    tempos.push_back(elapsedMs(inicio));
+  }
+
+  report(options, perfil, nome, std::move(tempos), itens);
+}
+
+// Gera doadores e doações com valores aleatórios, mas reproduzíveis a partir
+// da semente
+class Dataset {
+ public:
+  explicit Dataset(const Options& options)
+      : options(options), rng(options.semente) {}
+
+  // Telefone único para cada n, já no formato do formulário
+  static std::string Phone(int n) {
+    char telefone[16];
+    snprintf(telefone, sizeof(telefone), "(%02d) 9%04d-%04d",
+             11 + n / 100000000 % 89, n / 10000 % 10000, n % 10000);
+
+    return telefone;
+  }
+
+  Doador MakeDonor(int n) {
+    return Doador{-1, "Doador " + std::to_string(n), Phone(n)};
+  }
+
+  Doacao MakeDonation(int id_doador) {
+    static const char* const descricoes[] = {
+        "Casaco de lã", "Blusa de moletom", "Jaqueta jeans", "Cachecol",
+        "Luvas", ""};
+
+    return Doacao{-1,
+                  RandomDate(),
+                  PickCode<Tamanho>(kTamanhos),
+                  PickCode<Condicao>(kCondicoes),
+                  Chance(options.doados) ? Status::kDoado
+                                         : Status::kDisponivel,
+                  Pick(descricoes),
+                  id_doador};
+  }
+
+  // Data AAAAMMDD entre 2018 e 2025
+  int RandomDate() {
+    return Uniform(2018, 2025) * 10000 + Uniform(1, 12) * 100 +
+           Uniform(1, 28);
+  }
+
+  int Uniform(int min, int max) {
+    return std::uniform_int_distribution<int>(min, max)(rng);
+  }
+
+  bool Chance(double p) { return std::bernoulli_distribution(p)(rng); }
+
+  template <size_t N>
+  const char* Pick(const char* const (&valores)[N]) {
+    return valores[Uniform(0, static_cast<int>(N) - 1)];
+  }
+
+  // Código aleatório entre os que têm nome na tabela
+  template <typename Code, size_t N>
+  Code PickCode(const char* const (&)[N]) {
+    return static_cast<Code>(Uniform(0, static_cast<int>(N) - 1));
+  }
+
+ private:
+  const Options& options;
+  std::mt19937 rng;
+};
+
+void removeDatabase(const std::string& path) {
+  for (const char* sufixo : {"", "-wal", "-shm", "-journal"})
+    std::remove((path + sufixo).c_str());
+}
+
+// Cria um banco novo com options.doadores doadores e options.doacoes doações
+// distribuídas entre eles. As doações entram no registro de alterações, como
+// as cadastradas pelo aplicativo, para que a sincronização as leve junto
+void generate(const Options& options, const char* perfil,
+              const StorageProfile& profile, Dataset& dataset) {
+  removeDatabase(options.banco);
+
+  const auto inicio = Clock::now();
+
+  auto stor = openStorage(options.banco);
+  Queries queries(openForever(*stor, profile));
+
+  stor->transaction([&] {
+    std::vector<Doador> doadores;
+    doadores.reserve(options.doadores);
+
+    for (int n = 0; n < options.doadores; n++) {
+      doadores.push_back(dataset.MakeDonor(n));
+      doadores.back().id = queries.InsertDonor(doadores.back());
+    }
+
+    for (int n = 0; n < options.doacoes; n++) {
+      const Doador& doador =
+          doadores[dataset.Uniform(0, options.doadores - 1)];
+      const Doacao doacao = dataset.MakeDonation(doador.id);
+      queries.LogInsert(queries.InsertDonation(doacao), doacao, doador.nome,
+                        doador.telefone);
+    }
+
+    return true;
+  });
+
+  report(options, perfil, "gerar_banco", {elapsedMs(inicio)},
+         options.doadores + options.doacoes);
+}
+
+// CSV no formato aceito pela importação. Metade das linhas usa doadores que já
+// existem no banco
+std::string makeCsv(const Options& options, Dataset& dataset) {
+  std::string csv = "nome;telefone;data;tamanho;condicao;descricao;status\n";
+
+  for (int n = 0; n < options.importacao; n++) {
+    const int doador = n % 2 ? dataset.Uniform(0, options.doadores - 1)
+                             : options.doadores + n;
+    const Doacao doacao = dataset.MakeDonation(0);
+
+    char data[16];
+    decodeDate(doacao.data, data);
+
+    csv += "Doador " + std::to_string(doador) + ";" + Dataset::Phone(doador) +
+           ";" + data + ";" + codeName(doacao.tamanho) + ";" +
+           codeName(doacao.condicao) + ";" + doacao.descricao + ";" +
+           codeName(doacao.status) + "\n";
+  }
+
+  return csv;
+}
+
+// Confere que a importação aplicou todas as alterações exportadas e que as
+// doações da estação central, encontradas pela tabela replica, são iguais às
+// do banco de origem. Falha o bench em caso de diferença
+void checkSync(sqlite3* central, const std::string& origem, size_t exportadas,
+               const SyncResult& result) {
+  if (result.aplicadas != exportadas || !result.erros.empty()) {
+    throw std::runtime_error(
+        "Sincronização aplicou " + std::to_string(result.aplicadas) + " de " +
+        std::to_string(exportadas) + " alterações" +
+        (result.erros.empty() ? "" : ": " + result.erros.front()));
+  }
+
+  Statement attach(central, "ATTACH DATABASE ? AS origem");
+  attach.Bind(1, origem);
+  attach.Step();
+  attach.Reset();
+
+  size_t diferentes = 0;
+  {
+    // Doações que só existem de um dos lados ou com algum campo diferente,
+    // e doações de um lado que não estão na replica
+    Statement comparar(
+        central,
+        "SELECT (SELECT COUNT(*) FROM replica"
+        "  LEFT JOIN main.doacao c ON c.id = replica.doacao"
+        "  LEFT JOIN main.doador cd ON cd.id = c.id_doador"
+        "  LEFT JOIN origem.doacao o ON o.id = replica.doacao_origem"
+        "  LEFT JOIN origem.doador od ON od.id = o.id_doador"
+        "  WHERE (c.id IS NULL) != (o.id IS NULL)"
+        "   OR c.data != o.data OR c.tamanho != o.tamanho"
+        "   OR c.condicao != o.condicao OR c.status != o.status"
+        "   OR c.descricao != o.descricao OR cd.telefone IS NOT od.telefone)"
+        " + abs((SELECT COUNT(*) FROM main.doacao)"
+        "  - (SELECT COUNT(*) FROM origem.doacao))");
+    if (comparar.Step()) diferentes = comparar.ColumnInt(0);
+  }
+
+  Statement detach(central, "DETACH DATABASE origem");
+  detach.Step();
+
+  if (diferentes > 0) {
+    throw std::runtime_error(std::to_string(diferentes) +
+                             " doações da estação central diferem das do"
+                             " banco de origem");
+  }
+}
+
+void run(const Options& options, const char* perfil,
+         const StorageProfile& profile) {
+  Dataset dataset(options);
+  generate(options, perfil, profile, dataset);
+
+  // Abertura feita por App::StartUp(), com o esquema já atualizado, que pula
+  // o sync_schema()
+  measure(options, perfil, "abrir_banco", options.repeticoes, [&] {
+    auto stor = openStorage(options.banco);
+    openForever(*stor, profile);
+
+    return size_t(1);
+  });
+
+  auto stor = openStorage(options.banco);
+  sqlite3* db = openForever(*stor, profile);
+  Queries queries(db);
+  StockPager estoque(db);
+
+  // Leitura da aba "Doadores", feita por App::LoadDonors()
+  DonorCache doadores;
+  measure(options, perfil, "carregar_doadores", options.repeticoes,
+          [&] { return doadores.Load(db); });
+
+  // Índice de telefones montado por App::LoadPhones(), e as buscas que o
+  // cadastro faz nele para encontrar o doador
+  PhoneIndex telefones;
+  measure(options, perfil, "carregar_telefones", options.repeticoes, [&] {
+    const auto linhas =
+        stor->select(columns(&Doador::telefone_chave, &Doador::id),
+                     where(is_not_null(&Doador::telefone_chave)));
+
+    telefones.Clear();
+    telefones.Reserve(linhas.size());
+    for (const auto& [chave, id] : linhas) telefones.Insert(*chave, id);
+
+    return telefones.Size();
+  });
+
+  measure(options, perfil, "resolver_doador", options.repeticoes, [&] {
+    size_t encontrados = 0;
+    for (int n = 0; n < options.doadores; n++) {
+      if (telefones.Find(phoneKey(Dataset::Phone(n).c_str()))) encontrados++;
+    }
+
+    return encontrados;
+  });
+
+  measure(options, perfil, "contar_por_doador", options.repeticoes,
+          [&] { return countDonationsByDonor(*stor).size(); });
+
+  // Cópia colunar e totais da aba "Painel"
+  DonationSnapshot snapshot;
+  measure(options, perfil, "painel_carregar", options.repeticoes,
+          [&] { return snapshot.Load(db); });
+
+  measure(options, perfil, "painel_totais", options.repeticoes, [&] {
+    // Data fixa, para que todos os meses do conjunto sintético contem
+    return static_cast<size_t>(
+        DonationTotals::Compute(snapshot, 20251231).total);
+  });
+
+  // Aba de estoque: contagem depois de uma escrita, rolagem página a página,
+  // salto para o fim da tabela e troca de ordenação e de filtros. No
+  // aplicativo a contagem é feita pelo thread do banco; aqui, na mesma
+  // conexão
+  StockFilter disponiveis;
+
+  auto recontar = [&] {
+    estoque.Invalidate();
+    estoque.Refresh(estoque.Generation(),
+                    StockPager::Count(db, estoque.Filter()));
+  };
+
+  measure(options, perfil, "estoque_contar", options.repeticoes, [&] {
+    estoque.Configure(StockSort::kData, true, disponiveis);
+    recontar();
+
+    return size_t(1);
+  });
+
+  measure(options, perfil, "estoque_rolar", options.repeticoes, [&] {
+    recontar();
+
+    size_t lidas = 0;
+    for (int i = 0; i < 50 * StockPager::kPageSize; i += StockPager::kPageSize)
+      lidas += estoque.Load(i, i + StockPager::kPageSize);
+
+    return lidas;
+  });
+
+  measure(options, perfil, "estoque_saltar", options.repeticoes, [&] {
+    recontar();
+    return estoque.Load(estoque.Size() - 40, estoque.Size());
+  });
+
+  measure(options, perfil, "estoque_ordenar_doador", options.repeticoes, [&] {
+    estoque.Configure(StockSort::kDoador, true, disponiveis);
+    recontar();
+    const size_t lidas = estoque.Load(0, 40);
+    estoque.Configure(StockSort::kData, true, disponiveis);
+
+    return lidas;
+  });
+
+  // Filtro de período para um trimestre
+  measure(options, perfil, "estoque_periodo", options.repeticoes, [&] {
+    StockFilter periodo;
+    periodo.inicio = 20230101;
+    periodo.fim = 20230331;
+
+    estoque.Configure(StockSort::kData, true, periodo);
+    recontar();
+    const size_t lidas = estoque.Load(0, 40);
+    estoque.Configure(StockSort::kData, true, disponiveis);
+
+    return lidas;
+  });
+
+  // Busca digitada nas abas de estoque e de doadores, pelo índice de texto
+  measure(options, perfil, "estoque_buscar", options.repeticoes, [&] {
+    StockFilter busca;
+    busca.busca = "moletom";
+
+    estoque.Configure(StockSort::kData, true, busca);
+    recontar();
+    const size_t lidas = estoque.Load(0, 40);
+    estoque.Configure(StockSort::kData, true, disponiveis);
+
+    return lidas;
+  });
+
+  measure(options, perfil, "buscar_doadores", options.repeticoes,
+          [&] { return queries.SearchDonors("Doador 12").size(); });
+
+  // Escritas feitas pelo thread do banco, medidas uma a uma como acontecem
+  // quando o usuário cadastra, altera ou remove uma doação
+  std::vector<int> novas;
+
+  measure(options, perfil, "registrar_doacao", options.operacoes, [&] {
+    Doador doador = dataset.MakeDonor(
+        dataset.Chance(0.5) ? dataset.Uniform(0, options.doadores - 1)
+                            : options.doadores + options.importacao +
+                                  static_cast<int>(novas.size()));
+
+    stor->transaction([&] {
+      const auto existente = queries.FindDonorByPhone(doador.telefone);
+      const int id_doador =
+          existente ? *existente : queries.InsertDonor(doador);
+      const Doacao doacao = dataset.MakeDonation(id_doador);
+      novas.push_back(queries.InsertDonation(doacao));
+      queries.LogInsert(novas.back(), doacao, doador.nome, doador.telefone);
+
+      return true;
+    });
+
+    return size_t(1);
+  });
+
+  measure(options, perfil, "atualizar_status", options.operacoes, [&] {
+    const int id = dataset.Uniform(1, options.doacoes);
+    const Status status =
+        dataset.Chance(0.5) ? Status::kDoado : Status::kDisponivel;
+
+    stor->transaction([&] {
+      for (int alterada : queries.UpdateStatuses({id}, status))
+        queries.LogStatus(alterada, status);
+
+      return true;
+    });
+
+    return size_t(1);
+  });
+
+  // Entrega de um lote de agasalhos, marcado de uma vez na aba de estoque
+  measure(options, perfil, "atualizar_status_lote", options.repeticoes, [&] {
+    std::vector<int> ids;
+    for (int i = 0; i < 300; i++)
+      ids.push_back(dataset.Uniform(1, options.doacoes));
+
+    const Status status =
+        dataset.Chance(0.5) ? Status::kDoado : Status::kDisponivel;
+
+    size_t alteradas = 0;
+    stor->transaction([&] {
+      const std::vector<int> lista = queries.UpdateStatuses(ids, status);
+      for (int id : lista) queries.LogStatus(id, status);
+      alteradas = lista.size();
+
+      return true;
+    });
+
+    return alteradas;
+  });
+
+  size_t removidas = 0;
+  measure(options, perfil, "remover_doacao", options.operacoes, [&] {
+    const int id = novas[removidas++];
+
+    stor->transaction([&] {
+      for (const auto& removida : queries.RemoveDonations({id}))
+        queries.LogRemove(removida.first);
+
+      return true;
+    });
+
+    return size_t(1);
+  });
+
+  // Importação de planilha, com metade dos doadores novos
+  if (options.importacao > 0) {
+    std::istringstream csv(makeCsv(options, dataset));
+
+    measure(options, perfil, "importar_csv", 1, [&] {
+      CsvImporter importer(*stor, queries);
+      return importer.Import(csv).importadas;
+    });
+  }
+
+  // Sincronização: as alterações registradas acima são exportadas para um
+  // arquivo e importadas em um banco vazio, como o de uma estação central
+  const std::string arquivo = options.banco + ".ags";
+  const std::string central = options.banco + ".central";
+
+  size_t exportadas = 0;
+  measure(options, perfil, "sincronizar_exportar", 1, [&] {
+    exportadas = Replicator(*stor, queries).Export(arquivo, true);
+    return exportadas;
+  });
+
+  {
+    removeDatabase(central);
+    auto destino = openStorage(central);
+    Queries consultas(openForever(*destino, profile));
+
+    SyncResult result;
+    measure(options, perfil, "sincronizar_importar", 1, [&] {
+      result = Replicator(*destino, consultas).Import({arquivo});
+      return result.aplicadas;
+    });
+
+    checkSync(consultas.Connection(), options.banco, exportadas, result);
+  }
+
+  removeDatabase(central);
+  std::remove(arquivo.c_str());
+}
+
+bool parseOptions(int argc, char const* argv[], Options& options) {
+  for (int i = 1; i + 1 < argc; i += 2) {
+    const char* nome = argv[i];
+    const char* valor = argv[i + 1];
+
+    if (strcmp(nome, "--doadores") == 0) {
+      options.doadores = atoi(valor);
+    } else if (strcmp(nome, "--doacoes") == 0) {
+      options.doacoes = atoi(valor);
+    } else if (strcmp(nome, "--doados") == 0) {
+      options.doados = atof(valor);
+    } else if (strcmp(nome, "--repeticoes") == 0) {
+      options.repeticoes = atoi(valor);
+    } else if (strcmp(nome, "--operacoes") == 0) {
+      options.operacoes = atoi(valor);
+    } else if (strcmp(nome, "--importacao") == 0) {
+      options.importacao = atoi(valor);
+    } else if (strcmp(nome, "--perfil") == 0) {
+      options.perfil = valor;
+    } else if (strcmp(nome, "--banco") == 0) {
+      options.banco = valor;
+    } else if (strcmp(nome, "--semente") == 0) {
+      options.semente = static_cast<unsigned>(strtoul(valor, nullptr, 10));
+    } else {
+      fprintf(stderr, "Opção desconhecida: %s\n", nome);
+      return false;
+    }
+  }
+
+  if (argc % 2 == 0) {
+    fprintf(stderr, "Falta o valor de %s\n", argv[argc - 1]);
+    return false;
+  }
+
+  return options.doadores > 0 && options.doacoes > 0 &&
+         options.repeticoes > 0 && options.operacoes > 0 &&
+         options.importacao >= 0 && options.doados >= 0 &&
+         options.doados <= 1;
+}
+
+int main(int argc, char const* argv[]) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    fprintf(stderr,
+            "Uso: bench [--doadores N] [--doacoes N] [--doados 0.3] "
+            "[--repeticoes N] [--operacoes N] [--importacao N] "
+            "[--perfil app|sqlite|ambos] [--banco arquivo] [--semente N]\n");
+    return 2;
+  }
+
+  try {
+    if (options.perfil != "sqlite") run(options, "app", StorageProfile());
+    if (options.perfil != "app")
+      run(options, "sqlite", StorageProfile::SqliteDefaults());
+
+    removeDatabase(options.banco);
+  } catch (const std::exception& e) {
+    fprintf(stderr, "Erro: %s\n", e.what());
+    return 1;
+  }
+
+  return 0;
+}
@@ -1,31 +1,32 @@
 #include <imgui.h>
-#include <sqlite_orm/sqlite_orm.h>
 
+#include <algorithm>
+#include <chrono>
 #include <ctime>
+#include <fstream>
 #include <iostream>
 #include <memory>
-#include <regex>
+#include <optional>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include "app_base.hpp"
-
-using namespace sqlite_orm;
-
-struct Doador {
-  int id;
-  std::string nome;
-  std::string telefone;
-};
-
-struct Doacao {
-  int id;
-  std::string data;
-  std::string tamanho;
-  std::string condicao;
-  std::string status;
-  std::string descricao;
-  std::unique_ptr<int> id_doador;
-};
+#include "donation_snapshot.hpp"
+#include "donor_cache.hpp"
+#include "draft.hpp"
+#include "formatting.hpp"
+#include "importer.hpp"
+#include "phone_index.hpp"
+#include "profiler.hpp"
+#include "queries.hpp"
+#include "replication.hpp"
+#include "report.hpp"
+#include "stock_pager.hpp"
+#include "storage.hpp"
+#include "storage_worker.hpp"
 
 struct TextFilters {
   static int filter_phone(ImGuiInputTextCallbackData* data) {
@@ -50,97 +51,189 @@ struct TextFilters {
   };
 };
 
-void formatPhoneNumber(char* numero) {
-  // Remove todos os caracteres não numéricos do número
-  std::string clean_phone = std::regex_replace(numero, std::regex("\\D+"), "");
+class App : public AppBase<App> {
+ public:
+  App(StorageProfile perfil = StorageProfile()) : perfil(perfil){};
+  // Grava o rascunho ainda pendente antes que o thread do banco termine
+  virtual ~App() {
+    if (worker) SaveDraft(true);
+  }
 
-  // Verifica se o número é válido
-  if (clean_phone.length() < 10 || clean_phone.length() > 11) {
-    strcpy_s(numero, 16, "");
+  void StartUp() {
+    stor = profiler.Query("openStorage",
+                          [&] { return openStorage(kDatabasePath); });
+    conexao = profiler.Query("openForever",
+                             [&] { return openForever(*stor, perfil); });
+    buscas = std::make_unique<Queries>(conexao);
+    estoque = std::make_unique<StockPager>(conexao);
+
+    // As escritas vão para um thread próprio, que acorda a interface quando
+    // termina cada uma
+    worker = std::make_unique<StorageWorker>(kDatabasePath, perfil,
+                                             [this] { RequestRedraw(); });
+
+    // Volta ao cadastro que estava sendo digitado quando o aplicativo fechou
+    const auto rascunhos = profiler.Query(
+        "LoadDraft", [&] { return stor->get_all<Rascunho>(); });
+    if (!rascunhos.empty())
+      formulario = rascunho_salvo = FormDraft::FromRow(rascunhos.front());
+
+    // Os dados de cada aba são carregados na primeira vez em que ela é
+    // aberta. Só o índice de telefones começa a ser lido aqui, em segundo
+    // plano, para já estar pronto no primeiro cadastro
+    LoadPhones();
+    profiler.EndStartupStep("Banco de dados");
+  }
 
-    return;
+  // Descarta os dados das abas, que são lidos de novo quando cada uma for
+  // aberta. Depois de carregados, eles são mantidos atualizados pelas
+  // próprias escritas do aplicativo. O estoque é lido do banco por páginas,
+  // conforme a rolagem
+  void ResetCaches() {
+    doadores.Clear();
+    doacoes_por_doador.clear();
+    carga_doadores = Carga::kPendente;
+
+    telefones.Clear();
+    carga_telefones = Carga::kPendente;
+
+    doacoes.Clear();
+    carga_painel = Carga::kPendente;
+
+    estoque->Invalidate();
+    if (contagem_estoque == Carga::kFalhou)
+      contagem_estoque = Carga::kPendente;
+    doadores_sujo = true;
   }
 
-  // Aplica o formato adequado
-  std::string new_phone;
-  if (clean_phone.length() == 10) {
-    new_phone = std::regex_replace(
-        clean_phone, std::regex("(\\d{2})(\\d{4})(\\d{4})"), "($1) $2-$3");
-  } else {
-    new_phone = std::regex_replace(
-        clean_phone, std::regex("(\\d{2})(\\d{5})(\\d{4})"), "($1) $2-$3");
+  // Os doadores e o total de doações de cada um, lidos pelo thread do banco.
+  // Como ele executa as tarefas em ordem, a leitura já inclui as escritas
+  // enfileiradas antes dela, e as escritas seguintes são aplicadas sobre o
+  // resultado quando terminam
+  void LoadDonors() {
+    if (carga_doadores != Carga::kPendente || recarregar) return;
+    carga_doadores = Carga::kCarregando;
+
+    struct Leitura {
+      DonorCache doadores;
+      std::unordered_map<int, int> totais;
+      Profiler::Clock::time_point inicio, fim;
+    };
+    auto leitura = std::make_shared<Leitura>();
+
+    worker->Push(
+        [leitura](Storage& db, Queries& queries) {
+          leitura->inicio = Profiler::Clock::now();
+          leitura->doadores.Load(queries.Connection());
+          leitura->totais = countDonationsByDonor(db);
+          leitura->fim = Profiler::Clock::now();
+        },
+        [this, leitura](const char* erro) {
+          if (erro) return OnLoadError(carga_doadores, erro);
+
+          profiler.RecordQuery("LoadDonors", leitura->inicio, leitura->fim,
+                               leitura->doadores.Size());
+
+          doadores = std::move(leitura->doadores);
+          doacoes_por_doador = std::move(leitura->totais);
+          carga_doadores = Carga::kPronta;
+          doadores_sujo = true;
+        });
   }
 
-  // Copia o número formatado para o parâmetro original
-  strncpy_s(numero, 16, new_phone.c_str(), new_phone.length() + 1);
-}
+  // Chave do telefone -> id de todos os doadores, lida sem as outras colunas
+  void LoadPhones() {
+    if (carga_telefones != Carga::kPendente) return;
+    carga_telefones = Carga::kCarregando;
 
-void formatDate(char* data) {
-  // Remove todos os caracteres não numéricos da data
-  std::string dataLimpa = std::regex_replace(data, std::regex("\\D+"), "");
+    struct Leitura {
+      PhoneIndex telefones;
+      Profiler::Clock::time_point inicio, fim;
+    };
+    auto leitura = std::make_shared<Leitura>();
 
-  // Verifica se a data é válida
-  if (dataLimpa.length() != 8) {
-    strcpy_s(data, 16, "");
+    worker->Push(
+        [leitura](Storage& db, Queries&) {
+          leitura->inicio = Profiler::Clock::now();
 
-    return;
-  }
+          const auto linhas =
+              db.select(columns(&Doador::telefone_chave, &Doador::id),
+                        where(is_not_null(&Doador::telefone_chave)));
 
-  // Aplica o formato "DD/MM/YYYY"
-  snprintf(data, 11, "%s/%s/%s", dataLimpa.substr(0, 2).c_str(),
-           dataLimpa.substr(2, 2).c_str(), dataLimpa.substr(4).c_str());
-}
-
-bool validatePhone(const char* phone) {
-  std::regex reg("\\(\\d{2}\\)\\s\\d{5}-\\d{4}");
-
-  return std::regex_match(phone, reg);
-}
-
-bool validateDate(const char* date) {
-  std::regex reg("\\d{2}/\\d{2}/\\d{4}");
-
-  return std::regex_match(date, reg);
-}
-
-inline auto initStorage(const std::string& path) {
-  return make_storage(
-      path,
-
-      make_table("doador",
-                 make_column("id", &Doador::id, primary_key().autoincrement()),
-                 make_column("nome", &Doador::nome),
-                 make_column("telefone", &Doador::telefone)),
-      make_table("doacao",
-                 make_column("id", &Doacao::id, primary_key().autoincrement()),
-                 make_column("data", &Doacao::data),
-                 make_column("tamanho", &Doacao::tamanho),
-                 make_column("condicao", &Doacao::condicao),
-                 make_column("status", &Doacao::status),
-                 make_column("descricao", &Doacao::descricao),
-                 make_column("id_doador", &Doacao::id_doador),
-                 foreign_key(&Doacao::id_doador).references(&Doador::id)));
-};
+          leitura->telefones.Reserve(linhas.size());
+          for (const auto& [chave, id] : linhas)
+            leitura->telefones.Insert(*chave, id);
 
-using Storage = decltype(initStorage(""));
+          leitura->fim = Profiler::Clock::now();
+        },
+        [this, leitura](const char* erro) {
+          if (erro) return OnLoadError(carga_telefones, erro);
 
-class App : public AppBase<App> {
- public:
-  App(){};
-  virtual ~App() = default;
+          profiler.RecordQuery("LoadPhones", leitura->inicio, leitura->fim,
+                               leitura->telefones.Size());
 
-  void StartUp() {
-    stor = std::make_unique<Storage>(initStorage("agasalhos.sqlite"));
-    stor->sync_schema();
+          telefones = std::move(leitura->telefones);
+          carga_telefones = Carga::kPronta;
+        });
+  }
+
+  // A cópia colunar das doações e os totais do painel, calculados também no
+  // thread do banco
+  void LoadDashboard() {
+    if (carga_painel != Carga::kPendente || recarregar) return;
+    carga_painel = Carga::kCarregando;
+
+    struct Leitura {
+      DonationSnapshot doacoes;
+      DonationTotals totais;
+      Profiler::Clock::time_point inicio, fim;
+    };
+    auto leitura = std::make_shared<Leitura>();
+
+    worker->Push(
+        [leitura](Storage&, Queries& queries) {
+          leitura->inicio = Profiler::Clock::now();
+          leitura->doacoes.Load(queries.Connection());
+          leitura->totais = DonationTotals::Compute(leitura->doacoes);
+          leitura->fim = Profiler::Clock::now();
+        },
+        [this, leitura](const char* erro) {
+          if (erro) return OnLoadError(carga_painel, erro);
+
+          profiler.RecordQuery("LoadDashboard", leitura->inicio, leitura->fim,
+                               leitura->doacoes.Size());
+
+          doacoes = std::move(leitura->doacoes);
+          totais = std::move(leitura->totais);
+          versao_totais = doacoes.Version();
+          carga_painel = Carga::kPronta;
+        });
   }
 
   void Update() {
+    // Aplica o resultado das escritas que o thread do banco concluiu. Depois
+    // de um erro ou de uma importação, os caches são recarregados assim que
+    // não houver mais escritas pendentes
+    worker->DispatchCompletions();
+    if (recarregar && worker->Idle()) {
+      ResetCaches();
+      recarregar = false;
+      LoadPhones();
+    }
+
+    // O formulário é comparado com o último rascunho a cada quadro, mas só
+    // vai para o banco a cada kDraftInterval
+    SaveDraft();
+
+    // Recolhe o relatório que terminou de ser gerado
+    if (relatorio.Running() && relatorio.Done())
+      resultado_relatorio = relatorio.Finish();
+
     ImGui::SetNextWindowPos(ImVec2(0.0f, 0.0f));
     ImGui::SetNextWindowSize(ImGui::GetIO().DisplaySize);
 
     ImGui::Begin("Doação de agasalhos", NULL,
                  ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoResize |
-                     ImGuiWindowFlags_AlwaysAutoResize |
                      ImGuiWindowFlags_NoBackground);
 
     if (ImGui::BeginTabBar("##tabs", ImGuiTabBarFlags_FittingPolicyScroll)) {
@@ -148,49 +241,47 @@ class App : public AppBase<App> {
         ImGui::Text("Dados pessoais");
         ImGui::Separator();
 
-        static char nome[256];
-        ImGui::InputTextWithHint("##nome", "Nome", nome, 256);
+        ImGui::InputTextWithHint("##nome", "Nome", formulario.nome, 256);
         ImGui::SameLine();
         ImGui::Text("Nome*");
 
-        static char telefone[16];
-        if (ImGui::InputTextWithHint("##telefone", "(__) _____-____", telefone,
-                                     16,
+        if (ImGui::InputTextWithHint("##telefone", "(__) _____-____",
+                                     formulario.telefone, 16,
                                      ImGuiInputTextFlags_CallbackCharFilter |
                                          ImGuiInputTextFlags_EnterReturnsTrue,
                                      TextFilters::filter_phone)) {
-          // Formatar o número de telefone, usando regex
-          formatPhoneNumber(telefone);
+          // Formatar o número de telefone, acrescentando o 9 dos celulares
+          normalizePhone(formulario.telefone);
         };
 
         ImGui::SameLine();
         ImGui::Text("Número de Telefone*");
 
+        // Sem o índice, o doador é procurado pelo thread do banco. Se a
+        // leitura falhou, o usuário pode pedir outra
+        if (carga_telefones == Carga::kFalhou) DrawLoading(carga_telefones);
+        LoadPhones();
+
         ImGui::Text("Informações do agasalho");
         ImGui::Separator();
 
-        // Pegar a data atual
-        static char data[16];
-
-        if (ImGui::InputTextWithHint("##data", "__/__/____", data, 16,
+        if (ImGui::InputTextWithHint("##data", "__/__/____", formulario.data,
+                                     16,
                                      ImGuiInputTextFlags_CallbackCharFilter |
                                          ImGuiInputTextFlags_EnterReturnsTrue,
                                      TextFilters::filter_date)) {
-          formatDate(data);
+          formatDate(formulario.data);
         };
 
         ImGui::SameLine();
         ImGui::Text("Data da doação*");
 
         // Cria um combo para selecionar o tamanho do agasalho
-        const char* tamanhos[] = {"P", "M", "G", "GG", "XG"};
-        static const char* tamanho_selecionado = "M";
-
-        if (ImGui::BeginCombo("##tamanhos", tamanho_selecionado)) {
-          for (int n = 0; n < IM_ARRAYSIZE(tamanhos); n++) {
-            bool is_selected = (tamanho_selecionado == tamanhos[n]);
-            if (ImGui::Selectable(tamanhos[n], is_selected))
-              tamanho_selecionado = tamanhos[n];
+        if (ImGui::BeginCombo("##tamanhos", codeName(formulario.tamanho))) {
+          for (int n = 0; n < IM_ARRAYSIZE(kTamanhos); n++) {
+            bool is_selected = (formulario.tamanho == Tamanho(n));
+            if (ImGui::Selectable(kTamanhos[n], is_selected))
+              formulario.tamanho = Tamanho(n);
 
             if (is_selected) ImGui::SetItemDefaultFocus();
           }
@@ -202,14 +293,11 @@ class App : public AppBase<App> {
         ImGui::Text("Tamanho*");
 
         // Cria um combo para selecionar a condição do agasalho
-        const char* condicoes[] = {"Novo", "Semi-novo", "Usado"};
-        static const char* condicao_selecionada = "Novo";
-
-        if (ImGui::BeginCombo("##condicao", condicao_selecionada)) {
-          for (int n = 0; n < IM_ARRAYSIZE(condicoes); n++) {
-            bool is_selected = (condicao_selecionada == condicoes[n]);
-            if (ImGui::Selectable(condicoes[n], is_selected))
-              condicao_selecionada = condicoes[n];
+        if (ImGui::BeginCombo("##condicao", codeName(formulario.condicao))) {
+          for (int n = 0; n < IM_ARRAYSIZE(kCondicoes); n++) {
+            bool is_selected = (formulario.condicao == Condicao(n));
+            if (ImGui::Selectable(kCondicoes[n], is_selected))
+              formulario.condicao = Condicao(n);
 
             if (is_selected) ImGui::SetItemDefaultFocus();
           }
@@ -220,8 +308,8 @@ class App : public AppBase<App> {
         ImGui::SameLine();
         ImGui::Text("Condição*");
 
-        static char descricao[256];
-        ImGui::InputTextWithHint("##descricao", "Descrição", descricao, 256);
+        ImGui::InputTextWithHint("##descricao", "Descrição",
+                                 formulario.descricao, 256);
         ImGui::SameLine();
         ImGui::Text("Descrição");
 
@@ -240,45 +328,34 @@ class App : public AppBase<App> {
 
         if (ImGui::Button("Registrar doação")) {
           // Verificar se os campos obrigatórios foram preenchidos
-          if (strlen(nome) == 0 || !validatePhone(telefone) ||
-              !validateDate(data)) {
+          if (strlen(formulario.nome) == 0 ||
+              !validatePhone(formulario.telefone) ||
+              !validateDate(formulario.data)) {
             ImGui::OpenPopup("Campos obrigatórios");
 
           } else {
             // Registrar nova doação, e criar um novo doador se necessário
-            // Verificar se um doador com o mesmo email já existe
-            auto doadores_com_mesmo_email = stor->get_all<Doador>(
-                where(c(&Doador::telefone) == std::string(telefone)));
-
-            int doador_id = -1;
-
-            if (doadores_com_mesmo_email.empty()) {
-              // O doador não existe, então vamos criar um novo
-              Doador doador{-1, nome, telefone};
-              doador_id = stor->insert(doador);
-            } else {
-              // O doador já existe, então vamos usar o doador existente
-              doador_id = doadores_com_mesmo_email[0].id;
-            }
-
-            Doacao doacao{
-                -1,
-                data,
-                tamanho_selecionado,
-                condicao_selecionada,
-                "Disponível",
-                descricao,
-                std::make_unique<int>(doador_id),
-            };
-
-            stor->insert(doacao);
+            RegisterDonation(Doador{-1, formulario.nome, formulario.telefone},
+                             Doacao{
+                                 -1,
+                                 encodeDate(formulario.data),
+                                 formulario.tamanho,
+                                 formulario.condicao,
+                                 Status::kDisponivel,
+                                 formulario.descricao,
+                                 std::nullopt,
+                             });
 
             // Limpar variáveis
-            *nome = 0;
-            *telefone = 0;
-            *data = 0;
-            tamanho_selecionado = "M";
-            condicao_selecionada = "Novo";
+            *formulario.nome = 0;
+            *formulario.telefone = 0;
+            *formulario.data = 0;
+            formulario.tamanho = Tamanho::kM;
+            formulario.condicao = Condicao::kNovo;
+
+            // O rascunho do cadastro que acabou de ser feito é descartado
+            // já, para não voltar ao formulário se o aplicativo cair
+            SaveDraft(true);
           }
         };
 
@@ -294,145 +371,529 @@ class App : public AppBase<App> {
         ImGui::SameLine();
         ImGui::Text("Exibir apenas agasalhos disponíveis");
 
-        const auto rows = stor->select(object<Doacao>());
-        ImGui::Columns(6, "doacoes");
-        ImGui::Separator();
-        ImGui::Text("Data da doação");
-        ImGui::NextColumn();
-        ImGui::Text("Tamanho");
-        ImGui::NextColumn();
-        ImGui::Text("Condição");
-        ImGui::NextColumn();
-        ImGui::Text("Descrição");
-        ImGui::NextColumn();
-        ImGui::Text("Doador");
-        ImGui::NextColumn();
-        ImGui::Text("Status");
-        ImGui::NextColumn();
-
-        for (auto& doacao : rows) {
-          if (apenas_disponiveis && doacao.status == "Doado") {
-            continue;
-          };
+        // Intervalo de datas, só é aplicado quando a data é válida
+        static char data_inicio[16];
+        static char data_fim[16];
 
-          ImGui::PushID(doacao.id);
+        ImGui::SetNextItemWidth(ImGui::CalcTextSize("__/__/______").x);
+        if (ImGui::InputTextWithHint("##data_inicio", "__/__/____",
+                                     data_inicio, 16,
+                                     ImGuiInputTextFlags_CallbackCharFilter |
+                                         ImGuiInputTextFlags_EnterReturnsTrue,
+                                     TextFilters::filter_date)) {
+          formatDate(data_inicio);
+        };
 
-          ImGui::Text(doacao.data.c_str());
-          ImGui::NextColumn();
-          ImGui::Text(doacao.tamanho.c_str());
-          ImGui::NextColumn();
-          ImGui::Text(doacao.condicao.c_str());
-          ImGui::NextColumn();
+        ImGui::SameLine();
+        ImGui::Text("até");
+        ImGui::SameLine();
 
-          // Caso a descrição seja vazia, mostrar "Nenhuma descrição"
-          if (doacao.descricao.length() > 0) {
-            ImGui::Text(doacao.descricao.c_str());
-          } else {
-            ImGui::Text("Nenhuma descrição");
+        ImGui::SetNextItemWidth(ImGui::CalcTextSize("__/__/______").x);
+        if (ImGui::InputTextWithHint("##data_fim", "__/__/____", data_fim, 16,
+                                     ImGuiInputTextFlags_CallbackCharFilter |
+                                         ImGuiInputTextFlags_EnterReturnsTrue,
+                                     TextFilters::filter_date)) {
+          formatDate(data_fim);
+        };
+
+        ImGui::SameLine();
+        ImGui::Text("Período da doação");
+
+        // Busca refeita a cada caractere digitado
+        static char busca[128];
+        ImGui::InputTextWithHint("##busca_estoque", "Buscar na descrição",
+                                 busca, 128);
+
+        // Ações sobre as linhas selecionadas. Clique seleciona uma linha, Ctrl
+        // + clique inclui ou retira, e Shift + clique seleciona o intervalo
+        // desde o último clique
+        ImGui::Text("%zu selecionadas", selecao.size());
+        ImGui::SameLine();
+        if (ImGui::Button("Selecionar todas")) {
+          const std::vector<int> ids = profiler.Query("StockPager::Ids", [&] {
+            return estoque->Ids(0, estoque->Size());
+          });
+          selecao.insert(ids.begin(), ids.end());
+        }
+
+        // Alterações feitas durante o loop são aplicadas depois dele, já que
+        // modificam as páginas que estão sendo percorridas
+        std::vector<int> atualizar;
+        Status novo_status = Status::kDisponivel;
+        static std::vector<int> remover;
+        bool abrir_confirmacao = false;
+
+        ImGui::BeginDisabled(selecao.empty());
+        ImGui::SameLine();
+        if (ImGui::Button("Limpar seleção")) ClearSelection();
+
+        for (int n = 0; n < IM_ARRAYSIZE(kStatus); n++) {
+          const std::string rotulo = std::string("Marcar como ") + kStatus[n];
+
+          ImGui::SameLine();
+          if (ImGui::Button(rotulo.c_str())) {
+            atualizar.assign(selecao.begin(), selecao.end());
+            novo_status = Status(n);
           }
+        }
 
-          ImGui::NextColumn();
+        ImGui::SameLine();
+        if (ImGui::Button("Remover selecionadas")) {
+          remover.assign(selecao.begin(), selecao.end());
+          abrir_confirmacao = true;
+        }
+        ImGui::EndDisabled();
+
+        // Os filtros são aplicados pelo próprio SQL do estoque, que só
+        // consulta o banco de novo quando eles mudam
+        StockFilter filtro;
+        filtro.apenas_disponiveis = apenas_disponiveis;
+        filtro.inicio = validateDate(data_inicio) ? encodeDate(data_inicio) : 0;
+        filtro.fim = validateDate(data_fim) ? encodeDate(data_fim) : 0;
+        if (Queries::SearchLength(busca) >= Queries::kMinSearchLength)
+          filtro.busca = busca;
+
+        std::optional<int> clique;
+
+        const ImGuiTableFlags flags =
+            ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg |
+            ImGuiTableFlags_Resizable | ImGuiTableFlags_ScrollY |
+            ImGuiTableFlags_Sortable;
+
+        if (contagem_estoque == Carga::kFalhou) DrawLoading(contagem_estoque);
+
+        if (ImGui::BeginTable("doacoes", 6, flags,
+                              ImVec2(0.0f, ImGui::GetContentRegionAvail().y))) {
+          ImGui::TableSetupScrollFreeze(0, 1);
+          ImGui::TableSetupColumn("Data da doação",
+                                  ImGuiTableColumnFlags_DefaultSort, 0.0f,
+                                  static_cast<ImGuiID>(StockSort::kData));
+          ImGui::TableSetupColumn("Tamanho", 0, 0.0f,
+                                  static_cast<ImGuiID>(StockSort::kTamanho));
+          ImGui::TableSetupColumn("Condição", 0, 0.0f,
+                                  static_cast<ImGuiID>(StockSort::kCondicao));
+          ImGui::TableSetupColumn("Descrição", ImGuiTableColumnFlags_NoSort);
+          ImGui::TableSetupColumn("Doador", 0, 0.0f,
+                                  static_cast<ImGuiID>(StockSort::kDoador));
+          ImGui::TableSetupColumn("Status", 0, 0.0f,
+                                  static_cast<ImGuiID>(StockSort::kStatus));
+          ImGui::TableHeadersRow();
+
+          // A ordenação escolhida no cabeçalho vira o ORDER BY do estoque
+          static StockSort ordem = StockSort::kData;
+          static bool crescente = true;
+
+          ImGuiTableSortSpecs* especificacao = ImGui::TableGetSortSpecs();
+          if (especificacao && especificacao->SpecsDirty) {
+            if (especificacao->SpecsCount > 0) {
+              const ImGuiTableColumnSortSpecs& coluna =
+                  especificacao->Specs[0];
+
+              ordem = static_cast<StockSort>(coluna.ColumnUserID);
+              crescente = coluna.SortDirection == ImGuiSortDirection_Ascending;
+            }
 
-          auto doador = stor->get<Doador>(*doacao.id_doador);
+            especificacao->SpecsDirty = false;
+          }
 
-          ImGui::Text(doador.nome.c_str());
-          ImGui::NextColumn();
+          // A seleção vale para as linhas exibidas, então é descartada
+          // quando a ordenação ou os filtros mudam
+          if (estoque->Configure(ordem, crescente, filtro)) ClearSelection();
+          CountStock();
+
+          // Apenas as linhas visíveis na tela são desenhadas, e só as páginas
+          // delas são lidas do banco
+          ImGuiListClipper clipper;
+          clipper.Begin(estoque->Size());
+
+          while (clipper.Step()) {
+            if (!estoque->Loaded(clipper.DisplayStart, clipper.DisplayEnd)) {
+              profiler.Query("StockPager::Load", [&] {
+                return estoque->Load(clipper.DisplayStart, clipper.DisplayEnd);
+              });
+            }
 
-          const char* row_status = doacao.status.c_str();
-          const char* status[] = {"Disponível", "Doado"};
+            for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+              ImGui::TableNextRow();
+
+              const StockRow* doacao = estoque->At(i);
+              if (doacao == nullptr) continue;
+
+              ImGui::PushID(doacao->id);
+              ImGui::BeginDisabled(doacao->removida);
+
+              char data_doacao[16];
+              decodeDate(doacao->data, data_doacao);
+
+              const bool selecionada = selecao.count(doacao->id) > 0;
+              if (selecionada) {
+                ImGui::TableSetBgColor(ImGuiTableBgTarget_RowBg1,
+                                       ImGui::GetColorU32(ImGuiCol_Header));
+              }
+
+              ImGui::TableNextColumn();
+              if (ImGui::Selectable(data_doacao, selecionada)) clique = i;
+              ImGui::TableNextColumn();
+              ImGui::TextUnformatted(codeName(doacao->tamanho));
+              ImGui::TableNextColumn();
+              ImGui::TextUnformatted(codeName(doacao->condicao));
+              ImGui::TableNextColumn();
+
+              // Caso a descrição seja vazia, mostrar "Nenhuma descrição"
+              if (!doacao->descricao.empty()) {
+                ImGui::TextUnformatted(
+                    doacao->descricao.data(),
+                    doacao->descricao.data() + doacao->descricao.size());
+              } else {
+                ImGui::TextUnformatted("Nenhuma descrição");
+              }
+
+              ImGui::TableNextColumn();
+              ImGui::TextUnformatted(
+                  doacao->doador.data(),
+                  doacao->doador.data() + doacao->doador.size());
+              ImGui::TableNextColumn();
+
+              // Cria um combo para permitir alterar o status da doação
+              if (ImGui::BeginCombo("##status", codeName(doacao->status))) {
+                for (int n = 0; n < IM_ARRAYSIZE(kStatus); n++) {
+                  bool is_selected = (doacao->status == Status(n));
+                  if (ImGui::Selectable(kStatus[n], is_selected)) {
+                    atualizar = {doacao->id};
+                    novo_status = Status(n);
+                  };
+
+                  if (is_selected) ImGui::SetItemDefaultFocus();
+                }
+
+                ImGui::EndCombo();
+              };
 
-          // Cria um combo para permitir alterar o status da doação
-          if (ImGui::BeginCombo("##status", row_status)) {
-            for (int n = 0; n < IM_ARRAYSIZE(status); n++) {
-              bool is_selected = (row_status == status[n]);
-              if (ImGui::Selectable(status[n], is_selected)) {
-                Doacao temp_doacao = stor->get<Doacao>(doacao.id);
-                temp_doacao.status = status[n];
+              ImGui::SameLine();
 
-                // Atualiza o status da doação no banco de dados
-                stor->update(temp_doacao);
+              // Abrir Popup para confirmar a exclusão da doação
+              if (ImGui::SmallButton("X")) {
+                remover = {doacao->id};
+                abrir_confirmacao = true;
               };
 
-              if (is_selected) ImGui::SetItemDefaultFocus();
+              ImGui::EndDisabled();
+              ImGui::PopID();
             }
+          }
 
-            ImGui::EndCombo();
-          };
+          ImGui::EndTable();
+        }
 
-          ImGui::SameLine();
+        // O popup fica fora da tabela, já que a linha que o abriu pode deixar
+        // de ser desenhada
+        if (abrir_confirmacao) ImGui::OpenPopup("Deletar?");
 
-          // Abrir Popup para confirmar a exclusão da doação
-          if (ImGui::SmallButton("X")) {
-            ImGui::OpenPopup("Deletar?");
-          };
+        // Centralizar o popup
+        ImVec2 center = ImGui::GetMainViewport()->GetCenter();
+        ImGui::SetNextWindowPos(center, ImGuiCond_Appearing,
+                                ImVec2(0.5f, 0.5f));
 
-          // Centralizar o popup
-          ImVec2 center = ImGui::GetMainViewport()->GetCenter();
-          ImGui::SetNextWindowPos(center, ImGuiCond_Appearing,
-                                  ImVec2(0.5f, 0.5f));
-
-          // Popup para confirmar a exclusão da doação
-          if (ImGui::BeginPopupModal("Deletar?", NULL,
-                                     ImGuiWindowFlags_AlwaysAutoResize)) {
+        // Popup para confirmar a exclusão da doação
+        if (ImGui::BeginPopupModal("Deletar?", NULL,
+                                   ImGuiWindowFlags_AlwaysAutoResize)) {
+          if (remover.size() == 1) {
             ImGui::Text("Tem certeza que deseja deletar a doação?");
+          } else {
+            ImGui::Text("Tem certeza que deseja deletar as %zu doações?",
+                        remover.size());
+          }
 
-            if (ImGui::Button("OK", ImVec2(120, 0))) {
-              stor->remove<Doacao>(doacao.id);
+          if (ImGui::Button("OK", ImVec2(120, 0))) {
+            RemoveDonations(std::move(remover));
+            remover.clear();
 
-              ImGui::CloseCurrentPopup();
-            };
+            ImGui::CloseCurrentPopup();
+          };
 
-            ImGui::SetItemDefaultFocus();
-            ImGui::SameLine();
+          ImGui::SetItemDefaultFocus();
+          ImGui::SameLine();
 
-            if (ImGui::Button("Cancel", ImVec2(120, 0))) {
-              ImGui::CloseCurrentPopup();
-            };
+          if (ImGui::Button("Cancel", ImVec2(120, 0))) {
+            remover.clear();
 
-            ImGui::EndPopup();
+            ImGui::CloseCurrentPopup();
           };
 
-          ImGui::PopID();
-
-          ImGui::NextColumn();
+          ImGui::EndPopup();
         };
 
-        ImGui::Columns(1);
+        if (clique) SelectRow(*clique);
+        if (!atualizar.empty()) UpdateStatus(std::move(atualizar), novo_status);
 
         ImGui::EndTabItem();
       };
 
       // Nessa aba, o usuário pode ver os doadores e quantidade de doações
       if (ImGui::BeginTabItem("Doadores")) {
-        const auto rows = stor->select(object<Doador>());
+        LoadDonors();
 
-        ImGui::Columns(3, "doadores");
+        static char busca[128];
+        if (ImGui::InputTextWithHint("##busca_doadores",
+                                     "Buscar por nome ou telefone", busca,
+                                     128))
+          doadores_sujo = true;
+
+        if (doadores_sujo) RebuildDonorView(busca);
+
+        if (doadores_limitado) {
+          ImGui::SameLine();
+          ImGui::Text("Exibindo os primeiros %d resultados",
+                      Queries::kMaxSearchResults);
+        }
+
+        const auto& rows = doadores.Rows();
+        const ImGuiTableFlags flags =
+            ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg |
+            ImGuiTableFlags_Resizable | ImGuiTableFlags_ScrollY;
+
+        if (DrawLoading(carga_doadores) &&
+            ImGui::BeginTable("doadores", 3, flags,
+                              ImVec2(0.0f, ImGui::GetContentRegionAvail().y))) {
+          ImGui::TableSetupScrollFreeze(0, 1);
+          ImGui::TableSetupColumn("Nome");
+          ImGui::TableSetupColumn("Telefone");
+          ImGui::TableSetupColumn("Total de doações");
+          ImGui::TableHeadersRow();
+
+          ImGuiListClipper clipper;
+          clipper.Begin(static_cast<int>(doadores_visiveis.size()));
+
+          while (clipper.Step()) {
+            for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+              const DonorRow& doador = rows[doadores_visiveis[i]];
+
+              ImGui::TableNextRow();
+              ImGui::TableNextColumn();
+              ImGui::TextUnformatted(doador.nome.data(),
+                                     doador.nome.data() + doador.nome.size());
+              ImGui::TableNextColumn();
+              ImGui::TextUnformatted(
+                  doador.telefone.data(),
+                  doador.telefone.data() + doador.telefone.size());
+              ImGui::TableNextColumn();
+
+              // Quantidade de doações que o doador fez, já pré-calculada
+              auto total = doacoes_por_doador.find(doador.id);
+              const int doacoes =
+                  total != doacoes_por_doador.end() ? total->second : 0;
+
+              ImGui::Text("%d", doacoes);
+            }
+          }
+
+          ImGui::EndTable();
+        }
+
+        ImGui::EndTabItem();
+      };
+
+      // Nessa aba, o usuário vê os totais de doações por tipo de agasalho
+      // e por mês, para planejar a distribuição
+      if (ImGui::BeginTabItem("Painel")) {
+        LoadDashboard();
+
+        if (DrawLoading(carga_painel)) {
+          if (versao_totais != doacoes.Version()) {
+            totais = profiler.Query("DonationTotals::Compute", [&] {
+              return DonationTotals::Compute(doacoes);
+            });
+            versao_totais = doacoes.Version();
+          }
+
+          DrawDashboard();
+        }
+
+        ImGui::EndTabItem();
+      }
+
+      // Nessa aba, o usuário pode importar doações digitadas em planilhas
+      if (ImGui::BeginTabItem("Importar")) {
+        ImGui::Text("Importar doações de um arquivo CSV");
         ImGui::Separator();
-        ImGui::Text("Nome");
-        ImGui::NextColumn();
-        ImGui::Text("Telefone");
-        ImGui::NextColumn();
-        ImGui::Text("Total de doações");
-        ImGui::NextColumn();
-
-        for (auto& doador : rows) {
-          ImGui::Text(doador.nome.c_str());
-          ImGui::NextColumn();
-          ImGui::Text(doador.telefone.c_str());
-          ImGui::NextColumn();
-
-          // Conta quantas doações o doador fez
-          const auto doacoes =
-              stor->count<Doacao>(where(c(&Doacao::id_doador) == doador.id));
-
-          ImGui::Text("%d", doacoes);
-          ImGui::NextColumn();
+
+        ImGui::TextWrapped(
+            "O arquivo deve ter um cabeçalho com as colunas nome, telefone, "
+            "data, tamanho e condicao, e opcionalmente descricao e status.");
+
+        static char arquivo[512];
+        ImGui::InputTextWithHint("##arquivo", "doacoes.csv", arquivo, 512);
+        ImGui::SameLine();
+        ImGui::Text("Arquivo*");
+
+        if (importando) {
+          ImGui::Text("Importando...");
+        } else if (ImGui::Button("Importar") && strlen(arquivo) > 0) {
+          ImportCsv(arquivo);
+        }
+
+        if (importacao) {
+          ImGui::Separator();
+          ImGui::Text("Registros lidos: %zu", importacao->linhas);
+          ImGui::Text("Doações importadas: %zu", importacao->importadas);
+          ImGui::Text("Doadores novos: %zu", importacao->doadores_novos);
+          ImGui::Text("Linhas rejeitadas: %zu", importacao->rejeitadas);
+
+          for (const auto& erro : importacao->erros)
+            ImGui::TextUnformatted(erro.c_str());
+        }
+
+        ImGui::EndTabItem();
+      }
+
+      // Nessa aba, as alterações desta estação são exportadas para a
+      // central, e as das outras estações são importadas
+      if (ImGui::BeginTabItem("Sincronizar")) {
+        ImGui::Text("Sincronização entre estações de coleta");
+        ImGui::Separator();
+
+        if (!estacao) {
+          estacao = profiler.Query("localStation",
+                                   [&] { return localStation(*stor).id; });
+        }
+        ImGui::Text("Esta estação: %lld", *estacao);
+
+        static char destino[512];
+        static bool desde_inicio = false;
+        ImGui::InputTextWithHint("##destino", "alteracoes.ags", destino, 512);
+        ImGui::SameLine();
+        ImGui::Text("Exportar para*");
+        ImGui::Checkbox("Desde o início", &desde_inicio);
+
+        if (!sincronizando && ImGui::Button("Exportar") &&
+            strlen(destino) > 0)
+          ExportChanges(destino, desde_inicio);
+
+        if (exportadas)
+          ImGui::Text("Alterações exportadas: %zu", *exportadas);
+        if (erro_exportacao) ImGui::TextUnformatted(erro_exportacao->c_str());
+
+        ImGui::Separator();
+
+        static char origens[2048];
+        ImGui::InputTextWithHint("##origens", "estacao1.ags;estacao2.ags",
+                                 origens, 2048);
+        ImGui::SameLine();
+        ImGui::Text("Importar de*");
+
+        if (sincronizando) {
+          ImGui::Text("Sincronizando...");
+        } else if (ImGui::Button("Importar") && strlen(origens) > 0) {
+          ImportChanges(origens);
+        }
+
+        if (sincronizacao) {
+          ImGui::Separator();
+          ImGui::Text("Arquivos lidos: %zu", sincronizacao->arquivos);
+          ImGui::Text("Alterações lidas: %zu", sincronizacao->alteracoes);
+          ImGui::Text("Aplicadas: %zu", sincronizacao->aplicadas);
+          ImGui::Text("Já importadas: %zu", sincronizacao->repetidas);
+          ImGui::Text("De doações removidas: %zu", sincronizacao->ignoradas);
+          ImGui::Text("Aguardando outra estação: %zu",
+                      sincronizacao->pendentes);
+
+          for (const auto& erro : sincronizacao->erros)
+            ImGui::TextUnformatted(erro.c_str());
+        }
+
+        ImGui::EndTabItem();
+      }
+
+      // Nessa aba, a coordenação gera o relatório mensal de doações
+      // recebidas e entregues, em arquivos para planilhas ou outros sistemas
+      if (ImGui::BeginTabItem("Relatórios")) {
+        ImGui::Text("Relatório de doações recebidas e entregues por mês");
+        ImGui::Separator();
+
+        static char destino_relatorio[512];
+        ImGui::InputTextWithHint("##destino_relatorio", "relatorio",
+                                 destino_relatorio, 512);
+        ImGui::SameLine();
+        ImGui::Text("Salvar em*");
+
+        // Período opcional, aplicado só quando a data é válida
+        static char relatorio_inicio[16];
+        static char relatorio_fim[16];
+
+        ImGui::SetNextItemWidth(ImGui::CalcTextSize("__/__/______").x);
+        if (ImGui::InputTextWithHint("##relatorio_inicio", "__/__/____",
+                                     relatorio_inicio, 16,
+                                     ImGuiInputTextFlags_CallbackCharFilter |
+                                         ImGuiInputTextFlags_EnterReturnsTrue,
+                                     TextFilters::filter_date)) {
+          formatDate(relatorio_inicio);
         };
 
-        ImGui::Columns(1);
+        ImGui::SameLine();
+        ImGui::Text("até");
+        ImGui::SameLine();
+
+        ImGui::SetNextItemWidth(ImGui::CalcTextSize("__/__/______").x);
+        if (ImGui::InputTextWithHint("##relatorio_fim", "__/__/____",
+                                     relatorio_fim, 16,
+                                     ImGuiInputTextFlags_CallbackCharFilter |
+                                         ImGuiInputTextFlags_EnterReturnsTrue,
+                                     TextFilters::filter_date)) {
+          formatDate(relatorio_fim);
+        };
+
+        ImGui::SameLine();
+        ImGui::Text("Período");
+
+        static int formato = static_cast<int>(ReportFormat::kCsv);
+        ImGui::RadioButton("CSV", &formato,
+                           static_cast<int>(ReportFormat::kCsv));
+        ImGui::SameLine();
+        ImGui::RadioButton("JSON", &formato,
+                           static_cast<int>(ReportFormat::kJson));
+
+        static int maiores_doadores = ReportOptions().maiores_doadores;
+        ImGui::SetNextItemWidth(120.0f);
+        ImGui::InputInt("Maiores doadores", &maiores_doadores);
+        if (maiores_doadores < 1) maiores_doadores = 1;
+
+        if (relatorio.Running()) {
+          ImGui::ProgressBar(relatorio.Fraction());
+          if (ImGui::Button("Cancelar")) relatorio.Cancel();
+        } else if (ImGui::Button("Gerar relatório") &&
+                   strlen(destino_relatorio) > 0) {
+          ReportOptions options;
+          options.inicio = validateDate(relatorio_inicio)
+                               ? encodeDate(relatorio_inicio)
+                               : 0;
+          options.fim =
+              validateDate(relatorio_fim) ? encodeDate(relatorio_fim) : 0;
+          options.maiores_doadores = maiores_doadores;
+          options.formato = static_cast<ReportFormat>(formato);
+
+          resultado_relatorio.reset();
+          relatorio.Start(kDatabasePath, destino_relatorio, options,
+                          [this] { RequestRedraw(); });
+        }
+
+        if (resultado_relatorio) {
+          ImGui::Separator();
+          ImGui::Text("Doações no período: %zu", resultado_relatorio->doacoes);
+          ImGui::Text("Meses: %zu", resultado_relatorio->meses);
+          if (resultado_relatorio->sem_data)
+            ImGui::Text("Com data inválida, fora dos meses: %zu",
+                        resultado_relatorio->sem_data);
+          ImGui::Text("Doadores listados: %zu",
+                      resultado_relatorio->doadores);
+
+          for (const auto& arquivo : resultado_relatorio->arquivos)
+            ImGui::Text("Gravado em %s", arquivo.c_str());
+          for (const auto& erro : resultado_relatorio->erros)
+            ImGui::TextUnformatted(erro.c_str());
+        }
 
         ImGui::EndTabItem();
-      };
+      }
 
       // Apenas algumas informações sobre o projeto
       if (ImGui::BeginTabItem("Sobre")) {
@@ -450,9 +911,693 @@ class App : public AppBase<App> {
       ImGui::EndTabBar();
     };
 
+    // Avisa quando uma escrita falhou. As alterações que ela tinha feito nos
+    // caches são desfeitas pelo recarregamento
+    if (erro_escrita) {
+      ImGui::OpenPopup("Erro ao gravar");
+      ImGui::SetNextWindowPos(ImGui::GetMainViewport()->GetCenter(),
+                              ImGuiCond_Appearing, ImVec2(0.5f, 0.5f));
+    }
+
+    if (ImGui::BeginPopupModal("Erro ao gravar", NULL,
+                               ImGuiWindowFlags_AlwaysAutoResize)) {
+      if (erro_escrita) ImGui::TextUnformatted(erro_escrita->c_str());
+
+      if (ImGui::Button("OK", ImVec2(120, 0))) {
+        erro_escrita.reset();
+        ImGui::CloseCurrentPopup();
+      }
+
+      ImGui::EndPopup();
+    }
+
     ImGui::End();
   }
 
  private:
+  // As escritas abaixo alteram os caches e as páginas do estoque na hora (de
+  // forma otimista) e enfileiram a gravação no thread do banco. Doadores
+  // novos recebem um id temporário negativo, trocado pelo id real quando a
+  // gravação termina, e o estoque é relido do banco depois de cada gravação
+
+  void RegisterDonation(Doador doador, Doacao doacao) {
+    // Sem os doadores carregados, o thread do banco encontra o doador pelo
+    // telefone, e o cache só é atualizado quando a gravação termina
+    const bool otimista = carga_doadores == Carga::kPronta;
+
+    // Usa o doador com o mesmo telefone, caso já exista. Enquanto o índice
+    // não termina de carregar, o doador também é resolvido pelo thread
+    const long long chave = phoneKey(doador.telefone.c_str());
+    doador.telefone_chave = chave;
+
+    if (const auto existente = telefones.Find(chave)) {
+      doador.id = *existente;
+    } else {
+      doador.id = proximo_id_temporario--;
+      if (carga_telefones == Carga::kPronta) telefones.Insert(chave, doador.id);
+      if (otimista) doadores.Insert(doador);
+      doadores_sujo = true;
+    }
+
+    // Cópia que vai para o thread do banco, junto com o id real do doador
+    // que ele devolve
+    struct Registro {
+      Doador doador;
+      Doacao doacao;
+      int id_doador = 0;
+    };
+
+    auto registro =
+        std::make_shared<Registro>(Registro{doador, std::move(doacao)});
+
+    if (otimista) CountDonation(doador.id, 1);
+
+    PushTimed(
+        "RegisterDonation",
+        [this, registro](Storage& db, Queries& queries) {
+          db.transaction([&] {
+            registro->id_doador = ResolveDonor(queries, registro->doador);
+            registro->doacao.id_doador = registro->id_doador;
+            registro->doacao.id = queries.InsertDonation(registro->doacao);
+            queries.LogInsert(registro->doacao.id, registro->doacao,
+                              registro->doador.nome, registro->doador.telefone);
+
+            return true;
+          });
+
+          // Só registra o id depois que a transação foi confirmada
+          if (registro->doador.id < 0)
+            ids_reais[registro->doador.id] = registro->id_doador;
+        },
+        [this, registro, otimista, chave](const char* erro) {
+          if (erro) return OnWriteError(erro);
+
+          if (carga_telefones == Carga::kPronta)
+            telefones.Insert(chave, registro->id_doador);
+
+          // A doação passa a aparecer no estoque quando ele é relido
+          if (otimista) {
+            ConfirmDonor(registro->doador.id, registro->id_doador);
+          } else if (carga_doadores == Carga::kPronta) {
+            // Os doadores foram lidos antes desta gravação
+            Doador doador = registro->doador;
+            doador.id = registro->id_doador;
+            if (!doadores.Find(doador.id)) doadores.Insert(doador);
+
+            CountDonation(registro->id_doador, 1);
+            doadores_sujo = true;
+          }
+
+          doacoes.Insert(registro->doacao);
+          estoque->Invalidate();
+        });
+  }
+
+  // As linhas do estoque sempre vêm do banco, então os ids já são os reais.
+  // Todas as doações são alteradas por um único UPDATE, sem ler as linhas
+  // antes, e só as que mudaram de status vão para o registro de alterações
+  void UpdateStatus(std::vector<int> ids, Status status) {
+    // Atualiza o status nas páginas carregadas e no banco de dados
+    const std::unordered_set<int> alterar(ids.begin(), ids.end());
+    estoque->ForEachLoaded([&](StockRow& linha) {
+      if (alterar.count(linha.id)) linha.status = status;
+    });
+
+    auto alteradas = std::make_shared<std::vector<int>>();
+
+    PushTimed(
+        "UpdateStatus",
+        [ids = std::move(ids), status, alteradas](Storage& db,
+                                                  Queries& queries) {
+          db.transaction([&] {
+            *alteradas = queries.UpdateStatuses(ids, status);
+            for (int id : *alteradas) queries.LogStatus(id, status);
+
+            return true;
+          });
+        },
+        [this, status, alteradas](const char* erro) {
+          if (erro) return OnWriteError(erro);
+
+          for (int id : *alteradas) doacoes.SetStatus(id, status);
+          estoque->Invalidate();
+        });
+  }
+
+  // Remove as doações com um único DELETE. Os totais por doador são
+  // atualizados com o id_doador que o próprio DELETE devolve, já que as
+  // linhas selecionadas podem não estar nas páginas carregadas
+  void RemoveDonations(std::vector<int> ids) {
+    const std::unordered_set<int> remover(ids.begin(), ids.end());
+    estoque->ForEachLoaded([&](StockRow& linha) {
+      if (remover.count(linha.id)) linha.removida = true;
+    });
+
+    for (int id : ids) selecao.erase(id);
+
+    auto removidas = std::make_shared<std::vector<std::pair<int, int>>>();
+
+    PushTimed(
+        "RemoveDonations",
+        [ids = std::move(ids), removidas](Storage& db, Queries& queries) {
+          db.transaction([&] {
+            *removidas = queries.RemoveDonations(ids);
+            for (const auto& [id, id_doador] : *removidas)
+              queries.LogRemove(id);
+
+            return true;
+          });
+        },
+        [this, removidas](const char* erro) {
+          if (erro) return OnWriteError(erro);
+
+          // Se os doadores ainda não estavam carregados, a leitura deles já
+          // veio sem estas doações
+          for (const auto& [id, id_doador] : *removidas) {
+            if (carga_doadores == Carga::kPronta)
+              CountDonation(id_doador, -1);
+            doacoes.Remove(id);
+          }
+
+          estoque->Invalidate();
+        });
+  }
+
+  // Pede ao thread do banco a contagem das linhas do estoque, que percorre
+  // todas as doações filtradas. Como as tarefas rodam em ordem, ela já inclui
+  // as escritas enfileiradas antes. Uma só contagem fica pendente por vez, e
+  // a que chega depois de outra troca de filtros ou escrita é refeita
+  void CountStock() {
+    if (!estoque->Dirty() || contagem_estoque == Carga::kCarregando ||
+        contagem_estoque == Carga::kFalhou)
+      return;
+    contagem_estoque = Carga::kCarregando;
+
+    struct Contagem {
+      unsigned geracao;
+      StockFilter filtro;
+      int total = 0;
+      Profiler::Clock::time_point inicio, fim;
+    };
+    auto contagem = std::make_shared<Contagem>(
+        Contagem{estoque->Generation(), estoque->Filter()});
+
+    worker->Push(
+        [contagem](Storage&, Queries& queries) {
+          contagem->inicio = Profiler::Clock::now();
+          contagem->total =
+              StockPager::Count(queries.Connection(), contagem->filtro);
+          contagem->fim = Profiler::Clock::now();
+        },
+        [this, contagem](const char* erro) {
+          if (erro) return OnLoadError(contagem_estoque, erro);
+
+          profiler.RecordQuery("StockPager::Count", contagem->inicio,
+                               contagem->fim, 1);
+          contagem_estoque = Carga::kPronta;
+          estoque->Refresh(contagem->geracao, contagem->total);
+        });
+  }
+
+  // Aplica o clique na linha index do estoque à seleção, conforme as teclas
+  // Ctrl e Shift
+  void SelectRow(int index) {
+    const ImGuiIO& io = ImGui::GetIO();
+
+    if (io.KeyShift && ancora) {
+      // O intervalo pode passar por páginas que não estão carregadas
+      const std::vector<int> ids = profiler.Query("StockPager::Ids", [&] {
+        return estoque->Ids(std::min(*ancora, index),
+                            std::max(*ancora, index) + 1);
+      });
+
+      if (!io.KeyCtrl) selecao.clear();
+      selecao.insert(ids.begin(), ids.end());
+      return;
+    }
+
+    const StockRow* linha = estoque->At(index);
+    if (linha == nullptr) return;
+
+    if (io.KeyCtrl) {
+      if (!selecao.erase(linha->id)) selecao.insert(linha->id);
+    } else {
+      selecao = {linha->id};
+    }
+
+    ancora = index;
+  }
+
+  // Enfileira a gravação do formulário no thread do banco, caso ele tenha
+  // mudado desde o último rascunho e o último tenha sido gravado há pelo menos
+  // kDraftInterval. As edições feitas nesse meio tempo são juntadas em uma
+  // única gravação, feita no primeiro quadro depois do intervalo (no máximo
+  // idle_timeout depois, já que a janela redesenha mesmo parada). Com force,
+  // grava sem esperar
+  void SaveDraft(bool force = false) {
+    if (formulario == rascunho_salvo) return;
+
+    const auto agora = Profiler::Clock::now();
+    if (!force && agora - ultimo_rascunho < kDraftInterval) return;
+
+    rascunho_salvo = formulario;
+    ultimo_rascunho = agora;
+
+    StorageWorker::Task tarefa;
+    if (formulario.Empty()) {
+      tarefa = [](Storage&, Queries& queries) { queries.ClearDraft(); };
+    } else {
+      tarefa = [rascunho = formulario.ToRow()](Storage&, Queries& queries) {
+        queries.SaveDraft(rascunho);
+      };
+    }
+
+    PushTimed("SaveDraft", std::move(tarefa), [this](const char* erro) {
+      if (erro) OnWriteError(erro);
+    });
+  }
+
+  void ClearSelection() {
+    selecao.clear();
+    ancora.reset();
+  }
+
+  void ImportCsv(const char* arquivo) {
+    importacao.emplace();
+
+    auto in = std::make_shared<std::ifstream>(arquivo, std::ios::binary);
+    if (!*in) {
+      importacao->erros.push_back("Não foi possível abrir o arquivo");
+      return;
+    }
+
+    // A importação roda inteira no thread do banco, e escreve direto nele,
+    // então os caches são recarregados quando ela termina
+    auto result = std::make_shared<ImportResult>();
+    importando = true;
+
+    PushTimed(
+        "ImportCsv",
+        [in, result](Storage& db, Queries& queries) {
+          *result = CsvImporter(db, queries).Import(*in);
+        },
+        [this, result](const char* erro) {
+          importacao = *result;
+          if (erro) importacao->erros.push_back(erro);
+
+          importando = false;
+          recarregar = true;
+        });
+  }
+
+  void ExportChanges(const char* arquivo, bool desde_inicio) {
+    auto quantidade = std::make_shared<size_t>(0);
+    std::string destino = arquivo;
+    sincronizando = true;
+
+    PushTimed(
+        "ExportChanges",
+        [destino, desde_inicio, quantidade](Storage& db, Queries& queries) {
+          *quantidade = Replicator(db, queries).Export(destino, desde_inicio);
+        },
+        [this, quantidade](const char* erro) {
+          sincronizando = false;
+          if (erro) {
+            exportadas.reset();
+            erro_exportacao = erro;
+            return;
+          }
+
+          exportadas = *quantidade;
+          erro_exportacao.reset();
+        });
+  }
+
+  // Os arquivos vêm separados por ';'
+  void ImportChanges(const char* lista) {
+    std::vector<std::string> arquivos;
+    std::string texto = lista;
+
+    for (size_t inicio = 0; inicio <= texto.size();) {
+      size_t fim = texto.find(';', inicio);
+      if (fim == std::string::npos) fim = texto.size();
+
+      const size_t proximo = fim + 1;
+      while (inicio < fim && isSpace(texto[inicio])) inicio++;
+      while (fim > inicio && isSpace(texto[fim - 1])) fim--;
+
+      if (fim > inicio) arquivos.push_back(texto.substr(inicio, fim - inicio));
+      inicio = proximo;
+    }
+
+    if (arquivos.empty()) return;
+
+    // Como na importação de CSV, as alterações são gravadas direto no banco
+    // e os caches são recarregados no final
+    auto result = std::make_shared<SyncResult>();
+    sincronizando = true;
+
+    PushTimed(
+        "ImportChanges",
+        [arquivos, result](Storage& db, Queries& queries) {
+          *result = Replicator(db, queries).Import(arquivos);
+        },
+        [this, result](const char* erro) {
+          sincronizacao = *result;
+          if (erro) sincronizacao->erros.push_back(erro);
+
+          sincronizando = false;
+          recarregar = true;
+        });
+  }
+
+  // Troca o id temporário do doador pelo id real em todos os caches
+  void ConfirmDonor(int temporario, int real) {
+    if (temporario >= 0) return;
+
+    if (doadores.Find(real)) {
+      doadores.Remove(temporario);
+    } else {
+      doadores.Rekey(temporario, real);
+    }
+    doadores_sujo = true;
+
+    auto total = doacoes_por_doador.find(temporario);
+    if (total != doacoes_por_doador.end()) {
+      const int doacoes = total->second;
+      doacoes_por_doador.erase(total);
+      doacoes_por_doador[real] += doacoes;
+    }
+  }
+
+  // Soma delta ao total de doações do doador
+  void CountDonation(int id_doador, int delta) {
+    auto total = doacoes_por_doador.find(id_doador);
+    if (total == doacoes_por_doador.end()) {
+      if (delta > 0) doacoes_por_doador[id_doador] = delta;
+    } else if ((total->second += delta) <= 0) {
+      doacoes_por_doador.erase(total);
+    }
+  }
+
+  void OnWriteError(const char* erro) {
+    erro_escrita = erro;
+    recarregar = true;
+  }
+
+  // Enfileira uma escrita no thread do banco medindo o tempo da tarefa lá,
+  // registrado no profiler quando ela termina, como as leituras das abas
+  void PushTimed(const char* nome, StorageWorker::Task tarefa,
+                 StorageWorker::Done done) {
+    struct Tempo {
+      Profiler::Clock::time_point inicio, fim;
+    };
+    auto tempo = std::make_shared<Tempo>();
+
+    worker->Push(
+        [tarefa = std::move(tarefa), tempo](Storage& db, Queries& queries) {
+          tempo->inicio = Profiler::Clock::now();
+          try {
+            tarefa(db, queries);
+          } catch (...) {
+            tempo->fim = Profiler::Clock::now();
+            throw;
+          }
+          tempo->fim = Profiler::Clock::now();
+        },
+        [this, nome, tempo, done = std::move(done)](const char* erro) {
+          profiler.RecordQuery(nome, tempo->inicio, tempo->fim, 0);
+          if (done) done(erro);
+        });
+  }
+
+  // Uma leitura que falhou não recarrega nada sozinha, senão um banco que
+  // não abre faria o aplicativo tentar de novo a cada quadro. A aba mostra o
+  // erro e só tenta outra vez quando o usuário pede
+  void OnLoadError(Carga& carga, const char* erro) {
+    carga = Carga::kFalhou;
+    erro_leitura = erro;
+  }
+
+  // Indica se os dados da aba estão prontos. Senão, mostra que ainda estão
+  // sendo lidos, ou o erro da leitura com um botão para tentar de novo
+  bool DrawLoading(Carga& carga) {
+    if (carga == Carga::kPronta) return true;
+
+    if (carga != Carga::kFalhou) {
+      ImGui::Text("Carregando...");
+      return false;
+    }
+
+    ImGui::Text("Erro ao ler o banco: %s",
+                erro_leitura ? erro_leitura->c_str() : "");
+    if (ImGui::Button("Tentar novamente")) carga = Carga::kPendente;
+
+    return false;
+  }
+
+  // Executado no thread do banco: procura o doador pelo telefone, ou o insere
+  int ResolveDonor(Queries& queries, const Doador& doador) {
+    if (doador.id >= 0) return doador.id;
+
+    auto real = ids_reais.find(doador.id);
+    if (real != ids_reais.end()) return real->second;
+
+    const auto existente = queries.FindDonorByPhone(doador.telefone);
+    return existente ? *existente : queries.InsertDonor(doador);
+  }
+
+  // Tabelas da aba "Painel", a partir dos totais já calculados
+  void DrawDashboard() {
+    const int disponiveis = [&] {
+      int total = 0;
+      for (const auto& condicoes : totais.por_tipo) {
+        for (const auto& status : condicoes)
+          total += status[static_cast<int>(Status::kDisponivel)];
+      }
+
+      return total;
+    }();
+
+    ImGui::Text("%d doações, %d disponíveis", totais.total, disponiveis);
+    if (totais.codigos_invalidos) {
+      ImGui::SameLine();
+      ImGui::Text("(%d com tamanho, condição ou status inválido)",
+                  totais.codigos_invalidos);
+    }
+    ImGui::Separator();
+
+    const ImGuiTableFlags flags = ImGuiTableFlags_Borders |
+                                  ImGuiTableFlags_RowBg |
+                                  ImGuiTableFlags_SizingStretchSame;
+
+    // Disponíveis e total de cada tamanho × condição, com os totais de cada
+    // tamanho na última coluna
+    ImGui::Text("Agasalhos disponíveis (total) por tamanho e condição");
+
+    if (ImGui::BeginTable("por_tipo", kCondicaoCount + 2, flags)) {
+      ImGui::TableSetupColumn("Tamanho");
+      for (const char* condicao : kCondicoes)
+        ImGui::TableSetupColumn(condicao);
+      ImGui::TableSetupColumn("Total");
+      ImGui::TableHeadersRow();
+
+      for (int tamanho = 0; tamanho < kTamanhoCount; tamanho++) {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted(kTamanhos[tamanho]);
+
+        int linha_disponiveis = 0;
+        int linha_total = 0;
+
+        for (int condicao = 0; condicao < kCondicaoCount; condicao++) {
+          const int* status = totais.por_tipo[tamanho][condicao];
+          const int celula_disponiveis =
+              status[static_cast<int>(Status::kDisponivel)];
+
+          int celula_total = 0;
+          for (int s = 0; s < kStatusCount; s++) celula_total += status[s];
+
+          ImGui::TableNextColumn();
+          ImGui::Text("%d (%d)", celula_disponiveis, celula_total);
+
+          linha_disponiveis += celula_disponiveis;
+          linha_total += celula_total;
+        }
+
+        ImGui::TableNextColumn();
+        ImGui::Text("%d (%d)", linha_disponiveis, linha_total);
+      }
+
+      ImGui::EndTable();
+    }
+
+    ImGui::Separator();
+
+    // Doações recebidas em cada mês, da mais recente para a mais antiga
+    ImGui::Text("Doações recebidas por mês");
+    if (totais.fora_do_periodo) {
+      ImGui::SameLine();
+      ImGui::Text("(%d com data inválida ou fora dos últimos %d meses)",
+                  totais.fora_do_periodo, DonationTotals::kMaxMonths);
+    }
+
+    if (ImGui::BeginTable("por_mes", kStatusCount + 2,
+                          flags | ImGuiTableFlags_ScrollY,
+                          ImVec2(0.0f, ImGui::GetContentRegionAvail().y))) {
+      ImGui::TableSetupScrollFreeze(0, 1);
+      ImGui::TableSetupColumn("Mês");
+      ImGui::TableSetupColumn("Recebidas");
+      for (const char* status : kStatus) ImGui::TableSetupColumn(status);
+      ImGui::TableHeadersRow();
+
+      const int meses = totais.MonthCount();
+
+      ImGuiListClipper clipper;
+      clipper.Begin(meses);
+
+      while (clipper.Step()) {
+        for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+          const int mes = meses - 1 - i;
+          const int absoluto = totais.primeiro_mes + mes;
+
+          int recebidas = 0;
+          for (const auto& por_status : totais.por_mes)
+            recebidas += por_status[mes];
+
+          ImGui::TableNextRow();
+          ImGui::TableNextColumn();
+          ImGui::Text("%02d/%04d", absoluto % 12 + 1, absoluto / 12);
+          ImGui::TableNextColumn();
+          ImGui::Text("%d", recebidas);
+
+          for (const auto& por_status : totais.por_mes) {
+            ImGui::TableNextColumn();
+            ImGui::Text("%d", por_status[mes]);
+          }
+        }
+      }
+
+      ImGui::EndTable();
+    }
+  }
+
+  // Recalcula quais doadores aparecem na aba de doadores, todos ou apenas os
+  // encontrados pela busca
+  void RebuildDonorView(const char* busca) {
+    doadores_visiveis.clear();
+    doadores_sujo = false;
+
+    doadores_limitado = false;
+
+    if (Queries::SearchLength(busca) < Queries::kMinSearchLength) {
+      doadores_visiveis.reserve(doadores.Size());
+      for (size_t i = 0; i < doadores.Size(); i++)
+        doadores_visiveis.push_back(i);
+
+      return;
+    }
+
+    const auto ids = profiler.Query(
+        "SearchDonors", [&] { return buscas->SearchDonors(busca); });
+
+    for (int id : ids) {
+      const size_t i = doadores.IndexOf(id);
+      if (i != doadores.npos) doadores_visiveis.push_back(i);
+    }
+
+    doadores_limitado =
+        static_cast<int>(ids.size()) == Queries::kMaxSearchResults;
+  }
+
+  // Configuração das conexões com o banco
+  StorageProfile perfil;
+
   std::unique_ptr<Storage> stor;
+
+  // Conexão de stor, usada pelas consultas feitas pela interface
+  sqlite3* conexao = nullptr;
+
+  // Consultas preparadas das buscas, na mesma conexão de stor
+  std::unique_ptr<Queries> buscas;
+
+  // Páginas da aba de estoque, lidas do banco conforme a rolagem
+  std::unique_ptr<StockPager> estoque;
+
+  // Ids das doações selecionadas no estoque, e a posição da linha do último
+  // clique, onde começa a seleção com Shift
+  std::unordered_set<int> selecao;
+  std::optional<int> ancora;
+
+  // Estado dos dados de uma aba, carregados na primeira vez em que ela é
+  // aberta
+  enum class Carga { kPendente, kCarregando, kPronta, kFalhou };
+
+  // Cópia residente da tabela doador, usada para listar os doadores
+  DonorCache doadores;
+  Carga carga_doadores = Carga::kPendente;
+
+  // Índice dos doadores pela chave do telefone, usado pelo cadastro. Doadores
+  // novos entram com o id temporário, trocado quando a gravação termina
+  PhoneIndex telefones;
+  Carga carga_telefones = Carga::kPendente;
+
+  // Índices (no cache) das linhas exibidas na aba de doadores
+  std::vector<size_t> doadores_visiveis;
+  bool doadores_sujo = true;
+  bool doadores_limitado = false;
+
+  // Cópia colunar da tabela doacao, usada pelos totais do painel, e os
+  // totais calculados na última versão dela
+  DonationSnapshot doacoes;
+  DonationTotals totais;
+  std::optional<unsigned> versao_totais;
+  Carga carga_painel = Carga::kPendente;
+
+  // Contagem das linhas do estoque, feita pelo thread do banco
+  Carga contagem_estoque = Carga::kPendente;
+
+  // Quantidade de doações de cada doador (id do doador -> total), mantida
+  // incrementalmente a cada doação inserida ou removida
+  std::unordered_map<int, int> doacoes_por_doador;
+
+  // Resultado da última importação feita pela aba "Importar"
+  std::optional<ImportResult> importacao;
+  bool importando = false;
+
+  // Id desta estação, e o resultado da última exportação e importação
+  // feitas pela aba "Sincronizar"
+  std::optional<long long> estacao;
+  std::optional<size_t> exportadas;
+  std::optional<std::string> erro_exportacao;
+  std::optional<SyncResult> sincronizacao;
+  bool sincronizando = false;
+
+  // Relatório da aba "Relatórios", gerado no thread próprio dele, e o
+  // resultado do último que terminou
+  ReportJob relatorio;
+  std::optional<ReportResult> resultado_relatorio;
+
+  // Campos do formulário de cadastro, o último rascunho deles enviado ao
+  // banco e quando ele foi enviado
+  static constexpr auto kDraftInterval = std::chrono::seconds(3);
+  FormDraft formulario;
+  FormDraft rascunho_salvo;
+  Profiler::Clock::time_point ultimo_rascunho;
+
+  // Ids temporários dos doadores ainda não gravados são negativos
+  int proximo_id_temporario = -1;
+
+  // Id temporário -> id real. Usado apenas pelo thread do banco
+  std::unordered_map<int, int> ids_reais;
+
+  std::optional<std::string> erro_escrita;
+  bool recarregar = false;
+
+  // Erro da última leitura de uma aba que falhou
+  std::optional<std::string> erro_leitura;
+
+  // Declarado por último, para que o thread termine antes dos outros membros
+  // que as tarefas usam serem destruídos
+  std::unique_ptr<StorageWorker> worker;
 };
@@ -1,6 +1,8 @@
 #include <GLFW/glfw3.h>
 #include <stdio.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cstdlib>
 #include <functional>
 #include <iostream>
@@ -8,6 +10,7 @@
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
+#include "profiler.hpp"
 
 static void ErrorCallback(int error, const char* description) {
   fprintf(stderr, "Glfw Error %d: %s\n", error, description);
@@ -18,13 +21,20 @@ struct AppConfig {
   int width = 1280;
   int height = 720;
 
+  // Power saving: with no user input and no pending redraw, the main loop
+  // blocks waiting for events instead of rendering frames continuously
+  bool power_saving = true;
+
+  // Longest time (in seconds) without rendering a frame while idle
+  double idle_timeout = 1.0;
+
   AppConfig() = default;
 };
 
 template <typename Derived>
 class AppBase {
  public:
-  AppBase(AppConfig config = AppConfig()) {
+  AppBase(AppConfig config = AppConfig()) : config(config) {
     glfwSetErrorCallback(ErrorCallback);
 
     if (!glfwInit()) std::exit(1);
@@ -42,6 +52,28 @@ class AppBase {
     glfwMakeContextCurrent(window);
     glfwSwapInterval(1);
 
+    // Callbacks used only to know when there was user input. They are
+    // installed before the ImGui backend, which chains them to its own
+    glfwSetWindowUserPointer(window, this);
+    glfwSetWindowFocusCallback(window,
+                               [](GLFWwindow* w, int) { OnActivity(w); });
+    glfwSetCursorEnterCallback(window,
+                               [](GLFWwindow* w, int) { OnActivity(w); });
+    glfwSetCursorPosCallback(
+        window, [](GLFWwindow* w, double, double) { OnActivity(w); });
+    glfwSetMouseButtonCallback(
+        window, [](GLFWwindow* w, int, int, int) { OnActivity(w); });
+    glfwSetScrollCallback(
+        window, [](GLFWwindow* w, double, double) { OnActivity(w); });
+    glfwSetKeyCallback(
+        window, [](GLFWwindow* w, int, int, int, int) { OnActivity(w); });
+    glfwSetCharCallback(window,
+                        [](GLFWwindow* w, unsigned int) { OnActivity(w); });
+    glfwSetWindowSizeCallback(window,
+                              [](GLFWwindow* w, int, int) { OnActivity(w); });
+    glfwSetWindowRefreshCallback(window,
+                                 [](GLFWwindow* w) { OnActivity(w); });
+
     // Setup Dear ImGui context
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
@@ -134,6 +166,8 @@ class AppBase {
     ImGui::GetStyle().ScaleAllSizes(2);
     ImGui::GetIO().FontGlobalScale = 2;
 
+    profiler.EndStartupStep("GLFW, OpenGL e ImGui");
+
     // Add custom fonts
     // ImGuiIO& io = ImGui::GetIO();
     // io.Fonts->AddFontFromFileTTF("../../../imgui/misc/fonts/Roboto-Medium.ttf",
@@ -154,17 +188,37 @@ class AppBase {
     // Initialize the underlying app
     StartUp();
 
+    bool first_frame = true;
+
     while (!glfwWindowShouldClose(window)) {
-      // Poll events like key presses, mouse movements etc.
-      glfwPollEvents();
+      profiler.BeginFrame();
+
+      // Poll events like key presses, mouse movements etc. When idle, block
+      // until an event arrives, a redraw is requested or the timeout expires
+      if (config.power_saving && pending_frames == 0 &&
+          !redraw_requested.exchange(false)) {
+        glfwWaitEventsTimeout(config.idle_timeout);
+        redraw_requested.store(false);
+      } else {
+        glfwPollEvents();
+      }
+      profiler.EndPhase(Profiler::kEvents);
 
       // Start the Dear ImGui frame
       ImGui_ImplOpenGL3_NewFrame();
       ImGui_ImplGlfw_NewFrame();
       ImGui::NewFrame();
+      profiler.EndPhase(Profiler::kNewFrame);
 
-      // Main loop of the underlying app
+      // Main loop of the underlying app, then the profiler overlay (F12)
       Update();
+      profiler.Draw();
+
+      // Widgets in use (text being typed, sliders being dragged) keep
+      // animating, so keep drawing while any of them is active
+      if (ImGui::IsAnyItemActive())
+        pending_frames = std::max(pending_frames, 1);
+      profiler.EndPhase(Profiler::kUpdate);
 
       // Rendering
       ImGui::Render();
@@ -175,16 +229,52 @@ class AppBase {
                    clear_color.z * clear_color.w, clear_color.w);
       glClear(GL_COLOR_BUFFER_BIT);
       ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+      profiler.EndPhase(Profiler::kRender);
 
       glfwSwapBuffers(window);
+      profiler.EndPhase(Profiler::kSwap);
+      profiler.EndFrame();
+
+      // Startup ends when the first frame is on screen
+      if (first_frame) {
+        profiler.EndStartupStep("Primeiro quadro");
+        profiler.LogStartup();
+        first_frame = false;
+      }
+
+      if (pending_frames > 0) pending_frames--;
     }
   }
 
+  // Asks for a new frame even without user input, e.g. after data changed.
+  // Can be called from any thread
+  void RequestRedraw() {
+    redraw_requested.store(true);
+    glfwPostEmptyEvent();
+  }
+
   void Update() { static_cast<Derived*>(this)->Update(); }
 
   void StartUp() { static_cast<Derived*>(this)->StartUp(); }
 
+ protected:
+  // Frame phase timings, plus the queries the app reports through Query()
+  Profiler profiler;
+
  private:
+  // ImGui needs a few frames after an input event to settle hover states,
+  // popups and layout changes
+  static constexpr int kFramesAfterInput = 3;
+
+  static void OnActivity(GLFWwindow* w) {
+    auto* app = static_cast<AppBase*>(glfwGetWindowUserPointer(w));
+    if (app) app->pending_frames = kFramesAfterInput;
+  }
+
+  AppConfig config;
+  int pending_frames = kFramesAfterInput;
+  std::atomic<bool> redraw_requested{false};
+
   GLFWwindow* window = nullptr;
   ImVec4 clear_color = ImVec4(0.1058, 0.1137f, 0.1255f, 1.00f);
 };
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+// Cache em memória das linhas de uma tabela, mantido ordenado pelo id para
+// permitir buscas binárias. Como os ids são autoincrementais, as inserções
+// feitas pelo aplicativo sempre vão para o final do vetor.
+template <typename T>
+class TableCache {
+ public:
+  void Reset(std::vector<T> new_rows) {
+    auto by_id = [](const T& a, const T& b) { return a.id < b.id; };
+    if (!std::is_sorted(new_rows.begin(), new_rows.end(), by_id))
+      std::sort(new_rows.begin(), new_rows.end(), by_id);
+
+    rows = std::move(new_rows);
+  }
+
+  const T* Find(int id) const {
+    auto it = LowerBound(id);
+    return (it != rows.end() && it->id == id) ? &*it : nullptr;
+  }
+
+  T* Find(int id) {
+    auto it = LowerBound(id);
+    return (it != rows.end() && it->id == id) ? &*it : nullptr;
+  }
+
+  // Insere a linha, ou substitui a existente caso o id já esteja no cache
+  void Insert(T row) {
+    auto it = LowerBound(row.id);
+    if (it != rows.end() && it->id == row.id) {
+      *it = std::move(row);
+    } else {
+      rows.insert(it, std::move(row));
+    }
+  }
+
+  // Troca o id de uma linha, mantendo a ordenação
+  bool Rekey(int old_id, int new_id) {
+    auto it = LowerBound(old_id);
+    if (it == rows.end() || it->id != old_id) return false;
+
+    T row = std::move(*it);
+    rows.erase(it);
+
+    row.id = new_id;
+    Insert(std::move(row));
+    return true;
+  }
+
+  bool Remove(int id) {
+    auto it = LowerBound(id);
+    if (it == rows.end() || it->id != id) return false;
+
+    rows.erase(it);
+    return true;
+  }
+
+  // Posição da linha em Rows(), ou npos caso o id não esteja no cache
+  size_t IndexOf(int id) const {
+    auto it = LowerBound(id);
+    if (it == rows.end() || it->id != id) return npos;
+
+    return static_cast<size_t>(it - rows.begin());
+  }
+
+  const std::vector<T>& Rows() const { return rows; }
+
+  // Permite alterar as linhas no lugar, desde que os ids não mudem
+  std::vector<T>& Rows() { return rows; }
+
+  size_t Size() const { return rows.size(); }
+
+  static constexpr size_t npos = static_cast<size_t>(-1);
+
+ private:
+  typename std::vector<T>::const_iterator LowerBound(int id) const {
+    return std::lower_bound(
+        rows.begin(), rows.end(), id,
+        [](const T& row, int value) { return row.id < value; });
+  }
+
+  typename std::vector<T>::iterator LowerBound(int id) {
+    return std::lower_bound(
+        rows.begin(), rows.end(), id,
+        [](const T& row, int value) { return row.id < value; });
+  }
+
+  std::vector<T> rows;
+};
@@ -0,0 +1,270 @@
+#pragma once
+
+#include <sqlite3.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <vector>
+
+#include "formatting.hpp"
+#include "queries.hpp"
+#include "storage.hpp"
+
+// Cópia colunar da tabela doacao, com as colunas usadas pelos agregados do
+// painel. Cada coluna é um vetor próprio, e as categorias ficam como os
+// códigos de um byte dos enums (cujo dicionário são kTamanhos, kCondicoes e
+// kStatus), então percorrer uma coluna lê apenas os bytes dela.
+//
+// As linhas ficam ordenadas pelo id, como no TableCache, e são mantidas
+// atualizadas pelas escritas do aplicativo depois que elas são gravadas.
+// Doações com um código fora do dicionário (de um banco corrompido ou
+// editado por fora) ficam de fora, só contadas, já que os códigos indexam
+// os histogramas do painel.
+class DonationSnapshot {
+ public:
+  // Lê a tabela inteira pela conexão recebida (a do thread do banco), e
+  // devolve quantas linhas foram lidas
+  size_t Load(sqlite3* db) {
+    Statement select(db,
+                     "SELECT id, data, tamanho, condicao, status, id_doador"
+                     " FROM doacao ORDER BY id");
+
+    Clear();
+    while (select.Step()) {
+      const int tamanho = select.ColumnInt(2);
+      const int condicao = select.ColumnInt(3);
+      const int estado = select.ColumnInt(4);
+      if (!ValidCodes(tamanho, condicao, estado)) {
+        invalidas++;
+        continue;
+      }
+
+      ids.push_back(select.ColumnInt(0));
+      datas.push_back(select.ColumnInt(1));
+      meses.push_back(MonthOf(datas.back()));
+      tamanhos.push_back(static_cast<uint8_t>(tamanho));
+      condicoes.push_back(static_cast<uint8_t>(condicao));
+      status.push_back(static_cast<uint8_t>(estado));
+      doadores.push_back(select.ColumnInt(5));
+    }
+
+    versao++;
+    return ids.size();
+  }
+
+  // Insere a doação já gravada, com o id e o id_doador reais
+  void Insert(const Doacao& doacao) {
+    if (!ValidCodes(static_cast<int>(doacao.tamanho),
+                    static_cast<int>(doacao.condicao),
+                    static_cast<int>(doacao.status))) {
+      invalidas++;
+      versao++;
+      return;
+    }
+
+    const size_t i = LowerBound(doacao.id);
+    if (i < ids.size() && ids[i] == doacao.id) return;
+
+    ids.insert(ids.begin() + i, doacao.id);
+    datas.insert(datas.begin() + i, doacao.data);
+    meses.insert(meses.begin() + i, MonthOf(doacao.data));
+    tamanhos.insert(tamanhos.begin() + i,
+                    static_cast<uint8_t>(doacao.tamanho));
+    condicoes.insert(condicoes.begin() + i,
+                     static_cast<uint8_t>(doacao.condicao));
+    status.insert(status.begin() + i, static_cast<uint8_t>(doacao.status));
+    doadores.insert(doadores.begin() + i,
+                    doacao.id_doador.value_or(0));
+
+    versao++;
+  }
+
+  void SetStatus(int id, Status novo) {
+    const size_t i = LowerBound(id);
+    if (i == ids.size() || ids[i] != id) return;
+    if (static_cast<int>(novo) >= kStatusCount) return;
+
+    status[i] = static_cast<uint8_t>(novo);
+    versao++;
+  }
+
+  void Remove(int id) {
+    const size_t i = LowerBound(id);
+    if (i == ids.size() || ids[i] != id) return;
+
+    ids.erase(ids.begin() + i);
+    datas.erase(datas.begin() + i);
+    meses.erase(meses.begin() + i);
+    tamanhos.erase(tamanhos.begin() + i);
+    condicoes.erase(condicoes.begin() + i);
+    status.erase(status.begin() + i);
+    doadores.erase(doadores.begin() + i);
+
+    versao++;
+  }
+
+  void Clear() {
+    ids.clear();
+    datas.clear();
+    meses.clear();
+    tamanhos.clear();
+    condicoes.clear();
+    status.clear();
+    doadores.clear();
+    invalidas = 0;
+
+    versao++;
+  }
+
+  size_t Size() const { return ids.size(); }
+
+  // Doações deixadas de fora por terem um código inválido
+  size_t Invalid() const { return invalidas; }
+
+  // Muda a cada alteração, para que os agregados saibam quando recalcular
+  unsigned Version() const { return versao; }
+
+  const std::vector<int>& Ids() const { return ids; }
+  const std::vector<int>& Dates() const { return datas; }
+  const std::vector<int>& Months() const { return meses; }
+  const std::vector<uint8_t>& Sizes() const { return tamanhos; }
+  const std::vector<uint8_t>& Conditions() const { return condicoes; }
+  const std::vector<uint8_t>& Statuses() const { return status; }
+  const std::vector<int>& Donors() const { return doadores; }
+
+  // Mês AAAAMMDD como AAAA * 12 + (MM - 1), contínuo entre os anos
+  static int MonthOf(int data) {
+    return data / 10000 * 12 + data / 100 % 100 - 1;
+  }
+
+ private:
+  static bool ValidCodes(int tamanho, int condicao, int estado) {
+    return tamanho >= 0 && tamanho < kTamanhoCount && condicao >= 0 &&
+           condicao < kCondicaoCount && estado >= 0 && estado < kStatusCount;
+  }
+
+  size_t LowerBound(int id) const {
+    return std::lower_bound(ids.begin(), ids.end(), id) - ids.begin();
+  }
+
+  std::vector<int> ids;
+  std::vector<int> datas;  // AAAAMMDD
+  std::vector<int> meses;  // derivada de datas, com MonthOf()
+  std::vector<uint8_t> tamanhos;
+  std::vector<uint8_t> condicoes;
+  std::vector<uint8_t> status;
+  std::vector<int> doadores;
+  size_t invalidas = 0;
+
+  unsigned versao = 0;
+};
+
+// Totais do painel: doações por tamanho × condição × status e por mês de
+// recebimento × status.
+//
+// Os meses vão no máximo até kMaxMonths para trás a partir do mês de hoje.
+// Doações fora desse período (datas 0 de bancos antigos, anos digitados
+// errado) entram nos totais por tipo, mas não nos meses: são contadas em
+// fora_do_periodo, para não esticar a tabela por milhares de meses vazios
+struct DonationTotals {
+  static constexpr int kMaxMonths = 120;
+
+  int por_tipo[kTamanhoCount][kCondicaoCount][kStatusCount] = {};
+
+  // Mês (DonationSnapshot::MonthOf) da primeira posição de por_mes
+  int primeiro_mes = 0;
+  std::vector<int> por_mes[kStatusCount];
+
+  int total = 0;
+  int fora_do_periodo = 0;
+  int codigos_invalidos = 0;  // DonationSnapshot::Invalid()
+
+  // hoje em AAAAMMDD
+  static DonationTotals Compute(const DonationSnapshot& snapshot,
+                                int hoje = todayDate()) {
+    DonationTotals totais;
+    const size_t n = snapshot.Size();
+    totais.total = static_cast<int>(n);
+    totais.codigos_invalidos = static_cast<int>(snapshot.Invalid());
+    if (n == 0) return totais;
+
+    const uint8_t* tamanho = snapshot.Sizes().data();
+    const uint8_t* condicao = snapshot.Conditions().data();
+    const uint8_t* status = snapshot.Statuses().data();
+    const int* mes = snapshot.Months().data();
+
+    // Primeiro e último mês com doações dentro do período
+    const int limite_fim = DonationSnapshot::MonthOf(hoje);
+    const int limite_inicio = limite_fim - kMaxMonths + 1;
+
+    int primeiro = INT_MAX;
+    int ultimo = INT_MIN;
+    for (size_t i = 0; i < n; i++) {
+      if (mes[i] < limite_inicio || mes[i] > limite_fim) continue;
+
+      primeiro = std::min(primeiro, mes[i]);
+      ultimo = std::max(ultimo, mes[i]);
+    }
+
+    // Nenhum mês: todas as doações vão para o mês extra
+    if (primeiro > ultimo) {
+      primeiro = 0;
+      ultimo = -1;
+    }
+
+    const int quantidade = ultimo - primeiro + 1;
+
+    // Primeiro a célula de cada linha (mês × tamanho × condição × status) é
+    // calculada coluna a coluna, em um laço sem desvios que o compilador
+    // vetoriza; as fora do período vão para um mês extra, depois do último.
+    // Depois as células são contadas em quatro histogramas intercalados, para
+    // que incrementos seguidos na mesma célula não esperem um pelo outro, e
+    // somadas no final
+    constexpr int kTipos = kTamanhoCount * kCondicaoCount * kStatusCount;
+    std::vector<int> chaves(n);
+
+    for (size_t i = 0; i < n; i++) {
+      const bool dentro = mes[i] >= primeiro && mes[i] <= ultimo;
+      chaves[i] = (dentro ? mes[i] - primeiro : quantidade) * kTipos +
+                  (tamanho[i] * kCondicaoCount + condicao[i]) * kStatusCount +
+                  status[i];
+    }
+
+    const size_t celulas = static_cast<size_t>(quantidade + 1) * kTipos;
+    std::vector<int> contagem(4 * celulas);
+    int* parcial[4] = {&contagem[0], &contagem[celulas], &contagem[2 * celulas],
+                       &contagem[3 * celulas]};
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+      parcial[0][chaves[i]]++;
+      parcial[1][chaves[i + 1]]++;
+      parcial[2][chaves[i + 2]]++;
+      parcial[3][chaves[i + 3]]++;
+    }
+    for (; i < n; i++) parcial[0][chaves[i]]++;
+
+    totais.primeiro_mes = primeiro;
+    for (auto& meses : totais.por_mes) meses.assign(quantidade, 0);
+
+    int* por_tipo = &totais.por_tipo[0][0][0];
+    for (size_t celula = 0; celula < celulas; celula++) {
+      const int total = parcial[0][celula] + parcial[1][celula] +
+                        parcial[2][celula] + parcial[3][celula];
+
+      por_tipo[celula % kTipos] += total;
+
+      const size_t posicao = celula / kTipos;
+      if (posicao < static_cast<size_t>(quantidade)) {
+        totais.por_mes[celula % kStatusCount][posicao] += total;
+      } else {
+        totais.fora_do_periodo += total;
+      }
+    }
+
+    return totais;
+  }
+
+  int MonthCount() const { return static_cast<int>(por_mes[0].size()); }
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <sqlite3.h>
+
+#include <string_view>
+#include <vector>
+
+#include "cache.hpp"
+#include "queries.hpp"
+#include "storage.hpp"
+#include "string_pool.hpp"
+
+// Linha da aba de doadores. Os textos apontam para o StringPool do cache
+struct DonorRow {
+  int id;
+  std::string_view nome;
+  std::string_view telefone;
+};
+
+// Cópia residente da tabela doador. As linhas são lidas direto do statement,
+// com os textos copiados para um único StringPool em vez de dois std::string
+// por doador, então carregar a tabela faz poucas alocações mesmo com
+// centenas de milhares de doadores, e Clear() libera tudo de uma vez.
+//
+// Os textos de linhas removidas ou substituídas continuam no pool até a
+// próxima carga, o que só acontece com os poucos doadores novos do cadastro
+class DonorCache {
+ public:
+  // Lê a tabela inteira, e devolve quantas linhas foram lidas
+  size_t Load(sqlite3* db) {
+    Statement select(db, "SELECT id, nome, telefone FROM doador ORDER BY id");
+
+    Clear();
+
+    std::vector<DonorRow> linhas;
+    while (select.Step()) {
+      linhas.push_back(DonorRow{
+          select.ColumnInt(0),
+          textos.Add(select.ColumnView(1)),
+          textos.Add(select.ColumnView(2)),
+      });
+    }
+
+    const size_t lidas = linhas.size();
+    cache.Reset(std::move(linhas));
+
+    return lidas;
+  }
+
+  void Clear() {
+    cache.Reset({});
+    textos.Clear();
+  }
+
+  // Insere o doador, ou substitui o existente caso o id já esteja no cache
+  void Insert(const Doador& doador) {
+    cache.Insert(DonorRow{doador.id, textos.Add(doador.nome),
+                          textos.Add(doador.telefone)});
+  }
+
+  const DonorRow* Find(int id) const { return cache.Find(id); }
+  bool Rekey(int old_id, int new_id) { return cache.Rekey(old_id, new_id); }
+  bool Remove(int id) { return cache.Remove(id); }
+  size_t IndexOf(int id) const { return cache.IndexOf(id); }
+
+  const std::vector<DonorRow>& Rows() const { return cache.Rows(); }
+  size_t Size() const { return cache.Size(); }
+
+  static constexpr size_t npos = TableCache<DonorRow>::npos;
+
+ private:
+  TableCache<DonorRow> cache;
+  StringPool textos;
+};
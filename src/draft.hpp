@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+
+#include "storage.hpp"
+
+// Buffers do formulário de cadastro, editados direto pelos campos do ImGui.
+// Ficam juntos para que o salvamento automático compare o formulário inteiro
+// com o último rascunho gravado, sem alocar nada a cada quadro
+struct FormDraft {
+  char nome[256] = {};
+  char telefone[16] = {};
+  char data[16] = {};
+  char descricao[256] = {};
+  Tamanho tamanho = Tamanho::kM;
+  Condicao condicao = Condicao::kNovo;
+
+  bool operator==(const FormDraft& outro) const {
+    return tamanho == outro.tamanho && condicao == outro.condicao &&
+           strcmp(nome, outro.nome) == 0 &&
+           strcmp(telefone, outro.telefone) == 0 &&
+           strcmp(data, outro.data) == 0 &&
+           strcmp(descricao, outro.descricao) == 0;
+  }
+
+  bool operator!=(const FormDraft& outro) const { return !(*this == outro); }
+
+  // Nada foi digitado: tamanho e condição sozinhos não formam um rascunho
+  bool Empty() const {
+    return !*nome && !*telefone && !*data && !*descricao;
+  }
+
+  Rascunho ToRow() const {
+    return Rascunho{1, nome, telefone, data, tamanho, condicao, descricao};
+  }
+
+  static FormDraft FromRow(const Rascunho& rascunho) {
+    FormDraft form;
+    snprintf(form.nome, sizeof(form.nome), "%s", rascunho.nome.c_str());
+    snprintf(form.telefone, sizeof(form.telefone), "%s",
+             rascunho.telefone.c_str());
+    snprintf(form.data, sizeof(form.data), "%s", rascunho.data.c_str());
+    snprintf(form.descricao, sizeof(form.descricao), "%s",
+             rascunho.descricao.c_str());
+
+    // Códigos fora dos enums voltam ao padrão do formulário
+    if (static_cast<int>(rascunho.tamanho) < kTamanhoCount)
+      form.tamanho = rascunho.tamanho;
+    if (static_cast<int>(rascunho.condicao) < kCondicaoCount)
+      form.condicao = rascunho.condicao;
+
+    return form;
+  }
+};
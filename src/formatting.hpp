@@ -0,0 +1,188 @@
+#pragma once
+
+#include <cstdio>
+#include <ctime>
+
+// Funções de formatação e validação dos campos de telefone e data. Trabalham
+// direto sobre os buffers de char, sem regex e sem alocar memória, já que são
+// chamadas a cada registro e em importações com milhões de linhas. Os buffers
+// de entrada/saída têm pelo menos 16 bytes, como os do formulário.
+
+inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+// Equivalente ao \s do std::regex no locale "C"
+inline bool isSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' ||
+         c == '\r';
+}
+
+// Copia os dígitos de texto para digitos (no máximo max) e devolve quantos
+// dígitos o texto possui ao todo
+inline int extractDigits(const char* texto, char* digitos, int max) {
+  int total = 0;
+  for (const char* c = texto; *c; c++) {
+    if (!isDigit(*c)) continue;
+
+    if (total < max) digitos[total] = *c;
+    total++;
+  }
+
+  return total;
+}
+
+inline void formatPhoneNumber(char* numero) {
+  // Remove todos os caracteres não numéricos do número
+  char digitos[11];
+  const int total = extractDigits(numero, digitos, 11);
+
+  // Verifica se o número é válido
+  if (total < 10 || total > 11) {
+    numero[0] = 0;
+
+    return;
+  }
+
+  // Aplica o formato "(DD) DDDD-DDDD" ou "(DD) DDDDD-DDDD"
+  const int prefixo = total - 6;
+  char* saida = numero;
+
+  *saida++ = '(';
+  *saida++ = digitos[0];
+  *saida++ = digitos[1];
+  *saida++ = ')';
+  *saida++ = ' ';
+  for (int i = 2; i < 2 + prefixo; i++) *saida++ = digitos[i];
+  *saida++ = '-';
+  for (int i = total - 4; i < total; i++) *saida++ = digitos[i];
+  *saida = 0;
+}
+
+// Chave numérica do telefone, usada para encontrar o doador: os dígitos como
+// um inteiro, com o 9 inicial dos celulares acrescentado aos números de 10
+// dígitos, para que "(11) 8765-4321" e "(11) 98765-4321" sejam o mesmo
+// telefone. Devolve 0 quando o texto não tem 10 ou 11 dígitos
+inline long long phoneKey(const char* telefone) {
+  char digitos[11];
+  const int total = extractDigits(telefone, digitos, 11);
+  if (total < 10 || total > 11) return 0;
+
+  long long chave = 0;
+  for (int i = 0; i < total; i++) {
+    // Celulares começam com 6 a 9 depois do DDD
+    if (total == 10 && i == 2 && digitos[i] >= '6') chave = chave * 10 + 9;
+    chave = chave * 10 + (digitos[i] - '0');
+  }
+
+  return chave;
+}
+
+// Escreve a chave de volta no formato "(DD) DDDDD-DDDD", ou "(DD) DDDD-DDDD"
+// para os telefones fixos
+inline void formatPhoneKey(long long chave, char* telefone) {
+  const bool celular = chave >= 10000000000LL;
+  const long long local = celular ? 1000000000LL : 100000000LL;
+
+  snprintf(telefone, 16, celular ? "(%02d) %05d-%04d" : "(%02d) %04d-%04d",
+           static_cast<int>(chave / local),
+           static_cast<int>(chave % local / 10000),
+           static_cast<int>(chave % 10000));
+}
+
+// Reescreve o telefone a partir da chave, no formato de formatPhoneNumber()
+// mas com o 9 dos celulares, e devolve a chave (0 se o número é inválido)
+inline long long normalizePhone(char* telefone) {
+  const long long chave = phoneKey(telefone);
+  if (chave != 0) {
+    formatPhoneKey(chave, telefone);
+  } else {
+    telefone[0] = 0;
+  }
+
+  return chave;
+}
+
+inline void formatDate(char* data) {
+  // Remove todos os caracteres não numéricos da data
+  char digitos[8];
+
+  // Verifica se a data é válida
+  if (extractDigits(data, digitos, 8) != 8) {
+    data[0] = 0;
+
+    return;
+  }
+
+  // Aplica o formato "DD/MM/YYYY"
+  char* saida = data;
+  for (int i = 0; i < 8; i++) {
+    if (i == 2 || i == 4) *saida++ = '/';
+    *saida++ = digitos[i];
+  }
+  *saida = 0;
+}
+
+// Converte uma data "DD/MM/YYYY" já validada para o número AAAAMMDD
+inline int encodeDate(const char* data) {
+  auto digits = [data](int start, int count) {
+    int value = 0;
+    for (int i = start; i < start + count; i++)
+      value = value * 10 + (data[i] - '0');
+
+    return value;
+  };
+
+  return digits(6, 4) * 10000 + digits(3, 2) * 100 + digits(0, 2);
+}
+
+// Converte o número AAAAMMDD de volta para "DD/MM/YYYY"
+inline void decodeDate(int numero, char* data) {
+  snprintf(data, 11, "%02d/%02d/%04d", numero % 100, numero / 100 % 100,
+           numero / 10000);
+}
+
+// Data de hoje, no horário local, como o número AAAAMMDD. Pode ser chamada
+// de qualquer thread
+inline int todayDate() {
+  const std::time_t agora = std::time(nullptr);
+  std::tm local{};
+#ifdef _WIN32
+  localtime_s(&local, &agora);
+#else
+  localtime_r(&agora, &local);
+#endif
+
+  return (local.tm_year + 1900) * 10000 + (local.tm_mon + 1) * 100 +
+         local.tm_mday;
+}
+
+// Confere o formato "(DD) DDDDD-DDDD"
+inline bool validatePhone(const char* phone) {
+  static const char kPadrao[] = "(dd)sddddd-dddd";
+
+  for (int i = 0; kPadrao[i]; i++) {
+    const char c = phone[i];
+
+    if (kPadrao[i] == 'd') {
+      if (!isDigit(c)) return false;
+    } else if (kPadrao[i] == 's') {
+      if (!isSpace(c)) return false;
+    } else if (c != kPadrao[i]) {
+      return false;
+    }
+  }
+
+  return phone[sizeof(kPadrao) - 1] == 0;
+}
+
+// Confere o formato "DD/MM/YYYY"
+inline bool validateDate(const char* date) {
+  static const char kPadrao[] = "dd/dd/dddd";
+
+  for (int i = 0; kPadrao[i]; i++) {
+    const char c = date[i];
+
+    if (kPadrao[i] == 'd' ? !isDigit(c) : c != kPadrao[i]) return false;
+  }
+
+  return date[sizeof(kPadrao) - 1] == 0;
+}
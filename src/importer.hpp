@@ -0,0 +1,300 @@
+#pragma once
+
+#include <cstring>
+#include <functional>
+#include <istream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "formatting.hpp"
+#include "phone_index.hpp"
+#include "queries.hpp"
+#include "storage.hpp"
+
+struct ImportResult {
+  size_t linhas = 0;  // registros lidos, sem contar o cabeçalho
+  size_t importadas = 0;
+  size_t doadores_novos = 0;
+  size_t rejeitadas = 0;
+
+  // Mensagens das primeiras linhas rejeitadas, ou do erro que impediu a
+  // importação de começar
+  std::vector<std::string> erros;
+};
+
+// Importa doações de um arquivo CSV lido em fluxo, sem carregá-lo inteiro na
+// memória. O cabeçalho precisa ter as colunas nome, telefone, data, tamanho e
+// condicao; descricao e status são opcionais. Aceita vírgula ou ponto e
+// vírgula como separador e campos entre aspas.
+//
+// Telefone e data passam pela mesma normalização e validação do formulário.
+// Os doadores são resolvidos pela chave do telefone em um PhoneIndex, e as
+// linhas são gravadas em transações de kBatchSize registros. Caso ocorra um
+// erro no banco, os lotes anteriores já gravados são mantidos.
+class CsvImporter {
+ public:
+  static constexpr size_t kBatchSize = 50000;
+  static constexpr size_t kMaxErrors = 100;
+
+  CsvImporter(Storage& stor, Queries& queries)
+      : stor(stor), queries(queries) {}
+
+  ImportResult Import(
+      std::istream& in,
+      const std::function<void(const ImportResult&)>& progresso = nullptr) {
+    ImportResult result;
+
+    // Usa o cabeçalho para descobrir o separador e a posição das colunas
+    std::string cabecalho;
+    if (!std::getline(in, cabecalho)) {
+      result.erros.push_back("Arquivo vazio");
+      return result;
+    }
+
+    if (cabecalho.compare(0, 3, "\xEF\xBB\xBF") == 0) cabecalho.erase(0, 3);
+    separador = cabecalho.find(';') != std::string::npos &&
+                        cabecalho.find(',') == std::string::npos
+                    ? ';'
+                    : ',';
+
+    if (!ReadHeader(cabecalho, result)) return result;
+    linha_fisica = 1;
+
+    LoadDonors();
+
+    while (ReadRecord(in)) {
+      result.linhas++;
+
+      // Linhas em branco são ignoradas
+      if (campos.size() == 1 && campos[0].empty()) continue;
+
+      ParseRecord(result);
+
+      if (pendentes.size() >= kBatchSize) {
+        Flush(result);
+        if (progresso) progresso(result);
+      }
+    }
+
+    Flush(result);
+    if (progresso) progresso(result);
+
+    return result;
+  }
+
+ private:
+  enum Coluna {
+    kNome,
+    kTelefone,
+    kData,
+    kTamanho,
+    kCondicao,
+    kDescricao,
+    kStatus,
+    kTotalColunas
+  };
+
+  struct Pendente {
+    std::string nome;
+    std::string telefone;
+    long long chave;
+    Doacao doacao;
+  };
+
+  bool ReadHeader(const std::string& cabecalho, ImportResult& result) {
+    static const char* nomes[kTotalColunas] = {
+        "nome", "telefone", "data", "tamanho", "condicao", "descricao",
+        "status"};
+
+    std::istringstream linha(cabecalho);
+    if (!ReadRecord(linha)) return false;
+
+    for (int i = 0; i < kTotalColunas; i++) {
+      posicoes[i] = -1;
+
+      for (size_t n = 0; n < campos.size(); n++) {
+        if (campos[n] == nomes[i]) posicoes[i] = static_cast<int>(n);
+      }
+
+      if (posicoes[i] == -1 && i < kDescricao) {
+        result.erros.push_back(std::string("Coluna obrigatória ausente: ") +
+                               nomes[i]);
+      }
+    }
+
+    return result.erros.empty();
+  }
+
+  // Lê o próximo registro para campos. Um campo entre aspas pode conter o
+  // separador, quebras de linha e aspas duplicadas ("")
+  bool ReadRecord(std::istream& in) {
+    if (!std::getline(in, linha)) return false;
+    inicio_registro = ++linha_fisica;
+
+    size_t usados = 0;
+    auto proximo = [&]() -> std::string& {
+      if (usados == campos.size()) campos.emplace_back();
+
+      std::string& campo = campos[usados++];
+      campo.clear();
+      return campo;
+    };
+
+    std::string* campo = &proximo();
+    bool entre_aspas = false;
+
+    for (size_t i = 0;; i++) {
+      if (i == linha.size()) {
+        // Um campo entre aspas continua na próxima linha do arquivo
+        if (entre_aspas && std::getline(in, linha)) {
+          linha_fisica++;
+          campo->push_back('\n');
+          i = static_cast<size_t>(-1);
+          continue;
+        }
+
+        break;
+      }
+
+      const char c = linha[i];
+
+      if (entre_aspas) {
+        if (c != '"') {
+          campo->push_back(c);
+        } else if (i + 1 < linha.size() && linha[i + 1] == '"') {
+          campo->push_back('"');
+          i++;
+        } else {
+          entre_aspas = false;
+        }
+      } else if (c == '"') {
+        entre_aspas = true;
+      } else if (c == separador) {
+        campo = &proximo();
+      } else if (c != '\r') {
+        campo->push_back(c);
+      }
+    }
+
+    campos.resize(usados);
+    return true;
+  }
+
+  const std::string& Field(Coluna coluna) const {
+    static const std::string vazio;
+
+    const int posicao = posicoes[coluna];
+    return posicao >= 0 && posicao < static_cast<int>(campos.size())
+               ? campos[posicao]
+               : vazio;
+  }
+
+  void Reject(ImportResult& result, const char* motivo) {
+    result.rejeitadas++;
+
+    if (result.erros.size() < kMaxErrors) {
+      result.erros.push_back("Linha " + std::to_string(inicio_registro) +
+                             ": " + motivo);
+    }
+  }
+
+  void ParseRecord(ImportResult& result) {
+    if (Field(kNome).empty()) return Reject(result, "nome vazio");
+
+    // Os buffers têm folga para valores digitados com espaços e pontuação,
+    // e as funções de formatação escrevem no máximo 16 bytes
+    char telefone[64];
+    char data[64];
+    snprintf(telefone, sizeof(telefone), "%s", Field(kTelefone).c_str());
+    snprintf(data, sizeof(data), "%s", Field(kData).c_str());
+
+    const long long chave = normalizePhone(telefone);
+    if (!validatePhone(telefone))
+      return Reject(result, "telefone inválido");
+
+    formatDate(data);
+    if (!validateDate(data)) return Reject(result, "data inválida");
+
+    const auto tamanho = parseCode<Tamanho>(Field(kTamanho), kTamanhos);
+    if (!tamanho) return Reject(result, "tamanho inválido");
+
+    const auto condicao = parseCode<Condicao>(Field(kCondicao), kCondicoes);
+    if (!condicao) return Reject(result, "condição inválida");
+
+    std::optional<Status> status = Status::kDisponivel;
+    if (!Field(kStatus).empty()) {
+      status = parseCode<Status>(Field(kStatus), kStatus);
+      if (!status) return Reject(result, "status inválido");
+    }
+
+    pendentes.push_back(Pendente{
+        Field(kNome),
+        telefone,
+        chave,
+        Doacao{-1, encodeDate(data), *tamanho, *condicao, *status,
+               Field(kDescricao), std::nullopt},
+    });
+  }
+
+  void LoadDonors() {
+    const auto linhas = stor.select(
+        columns(&Doador::telefone_chave, &Doador::id),
+        where(is_not_null(&Doador::telefone_chave)));
+
+    doadores.Clear();
+    doadores.Reserve(linhas.size());
+    for (const auto& [chave, id] : linhas) doadores.Insert(*chave, id);
+  }
+
+  // Grava o lote pendente em uma única transação
+  void Flush(ImportResult& result) {
+    if (pendentes.empty()) return;
+
+    size_t doadores_novos = 0;
+
+    stor.transaction([&] {
+      for (Pendente& pendente : pendentes) {
+        auto doador = doadores.Find(pendente.chave);
+
+        if (!doador) {
+          Doador novo{-1, pendente.nome, pendente.telefone, pendente.chave};
+          doador = queries.InsertDonor(novo);
+
+          doadores.Insert(pendente.chave, *doador);
+          doadores_novos++;
+        }
+
+        pendente.doacao.id_doador = *doador;
+        const int id = queries.InsertDonation(pendente.doacao);
+        queries.LogInsert(id, pendente.doacao, pendente.nome,
+                          pendente.telefone);
+      }
+
+      return true;
+    });
+
+    result.importadas += pendentes.size();
+    result.doadores_novos += doadores_novos;
+    pendentes.clear();
+  }
+
+  Storage& stor;
+  Queries& queries;
+  char separador = ',';
+  int posicoes[kTotalColunas];
+
+  // Linhas do arquivo lidas até agora, contando o cabeçalho e as quebras de
+  // linha dentro de campos entre aspas, e a linha onde o registro atual começa
+  size_t linha_fisica = 0;
+  size_t inicio_registro = 0;
+
+  // Buffers reaproveitados entre os registros
+  std::string linha;
+  std::vector<std::string> campos;
+
+  PhoneIndex doadores;
+  std::vector<Pendente> pendentes;
+};
@@ -1,6 +1,173 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
 #include "app.hpp"
 
+// Modo sem interface gráfica, para importações grandes ou agendadas:
+//   app --importar arquivo.csv [banco.sqlite]
+int runImport(const char* arquivo, const char* banco) {
+  std::ifstream in(arquivo, std::ios::binary);
+  if (!in) {
+    fprintf(stderr, "Não foi possível abrir %s\n", arquivo);
+    return 1;
+  }
+
+  const auto inicio = std::chrono::steady_clock::now();
+  ImportResult result;
+
+  try {
+    auto stor = openStorage(banco);
+    Queries queries(openForever(*stor, StorageProfile()));
+    CsvImporter importer(*stor, queries);
+
+    result = importer.Import(in, [](const ImportResult& parcial) {
+      fprintf(stderr, "%zu registros lidos, %zu importados\n", parcial.linhas,
+              parcial.importadas);
+    });
+  } catch (const std::exception& e) {
+    fprintf(stderr, "Erro: %s\n", e.what());
+    return 1;
+  }
+
+  const std::chrono::duration<double> duracao =
+      std::chrono::steady_clock::now() - inicio;
+
+  for (const auto& erro : result.erros) fprintf(stderr, "%s\n", erro.c_str());
+
+  printf("Registros lidos: %zu\n", result.linhas);
+  printf("Doações importadas: %zu\n", result.importadas);
+  printf("Doadores novos: %zu\n", result.doadores_novos);
+  printf("Linhas rejeitadas: %zu\n", result.rejeitadas);
+  printf("Tempo: %.2fs\n", duracao.count());
+
+  return result.importadas > 0 || result.erros.empty() ? 0 : 1;
+}
+
+// Sincronização entre estações sem interface gráfica, por exemplo agendada:
+//   app --exportar-alteracoes arquivo.ags [banco.sqlite]
+//   app --importar-alteracoes banco.sqlite arquivo.ags...
+int runExportChanges(const char* arquivo, const char* banco) {
+  try {
+    auto stor = openStorage(banco);
+    Queries queries(openForever(*stor, StorageProfile()));
+    Replicator replicator(*stor, queries);
+
+    const size_t quantidade = replicator.Export(arquivo);
+    printf("Estação: %lld\n", replicator.Station());
+    printf("Alterações exportadas: %zu\n", quantidade);
+  } catch (const std::exception& e) {
+    fprintf(stderr, "Erro: %s\n", e.what());
+    return 1;
+  }
+
+  return 0;
+}
+
+int runImportChanges(const char* banco, std::vector<std::string> arquivos) {
+  SyncResult result;
+
+  try {
+    auto stor = openStorage(banco);
+    Queries queries(openForever(*stor, StorageProfile()));
+
+    result = Replicator(*stor, queries).Import(arquivos);
+  } catch (const std::exception& e) {
+    fprintf(stderr, "Erro: %s\n", e.what());
+    return 1;
+  }
+
+  for (const auto& erro : result.erros) fprintf(stderr, "%s\n", erro.c_str());
+
+  printf("Arquivos lidos: %zu\n", result.arquivos);
+  printf("Alterações lidas: %zu\n", result.alteracoes);
+  printf("Aplicadas: %zu\n", result.aplicadas);
+  printf("Já importadas: %zu\n", result.repetidas);
+  printf("De doações removidas: %zu\n", result.ignoradas);
+  printf("Aguardando outra estação: %zu\n", result.pendentes);
+
+  return result.erros.empty() ? 0 : 1;
+}
+
+// Relatório mensal sem interface gráfica, por exemplo em um job noturno:
+//   app --relatorio destino [banco.sqlite] [--json] [--de DD/MM/AAAA]
+//       [--ate DD/MM/AAAA] [--doadores N]
+int runReport(const char* destino, std::vector<std::string> argumentos) {
+  std::string banco = kDatabasePath;
+  ReportOptions options;
+
+  for (size_t i = 0; i < argumentos.size(); i++) {
+    const std::string& argumento = argumentos[i];
+    const bool tem_valor = i + 1 < argumentos.size();
+
+    if (argumento == "--json") {
+      options.formato = ReportFormat::kJson;
+    } else if ((argumento == "--de" || argumento == "--ate") && tem_valor) {
+      char data[64];
+      snprintf(data, sizeof(data), "%s", argumentos[++i].c_str());
+      formatDate(data);
+
+      if (!validateDate(data)) {
+        fprintf(stderr, "Data inválida: %s\n", argumentos[i].c_str());
+        return 1;
+      }
+
+      (argumento == "--de" ? options.inicio : options.fim) = encodeDate(data);
+    } else if (argumento == "--doadores" && tem_valor) {
+      options.maiores_doadores = std::max(1, atoi(argumentos[++i].c_str()));
+    } else if (argumento.compare(0, 2, "--") != 0) {
+      banco = argumento;
+    } else {
+      fprintf(stderr, "Opção desconhecida: %s\n", argumento.c_str());
+      return 1;
+    }
+  }
+
+  ReportResult result;
+
+  try {
+    ReportProgress progresso;
+    progresso.notify = [&progresso] {
+      fprintf(stderr, "%zu de %zu doações lidas\n", progresso.lidas.load(),
+              progresso.total.load());
+    };
+
+    result = ReportGenerator(banco).Generate(destino, options, &progresso);
+  } catch (const std::exception& e) {
+    fprintf(stderr, "Erro: %s\n", e.what());
+    return 1;
+  }
+
+  for (const auto& erro : result.erros) fprintf(stderr, "%s\n", erro.c_str());
+
+  printf("Doações no período: %zu\n", result.doacoes);
+  printf("Meses: %zu\n", result.meses);
+  if (result.sem_data)
+    printf("Com data inválida, fora dos meses: %zu\n", result.sem_data);
+  printf("Doadores listados: %zu\n", result.doadores);
+  for (const auto& arquivo : result.arquivos)
+    printf("Gravado em %s\n", arquivo.c_str());
+
+  return result.erros.empty() ? 0 : 1;
+}
+
 int main(int argc, char const* argv[]) {
+  if (argc >= 3 && strcmp(argv[1], "--importar") == 0)
+    return runImport(argv[2], argc >= 4 ? argv[3] : kDatabasePath);
+
+  if (argc >= 3 && strcmp(argv[1], "--exportar-alteracoes") == 0)
+    return runExportChanges(argv[2], argc >= 4 ? argv[3] : kDatabasePath);
+
+  if (argc >= 4 && strcmp(argv[1], "--importar-alteracoes") == 0)
+    return runImportChanges(argv[2], {argv + 3, argv + argc});
+
+  if (argc >= 3 && strcmp(argv[1], "--relatorio") == 0)
+    return runReport(argv[2], {argv + 3, argv + argc});
+
   // Cria o aplicativo e o inicia
   App app;
   app.Run();
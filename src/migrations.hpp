@@ -0,0 +1,303 @@
+#pragma once
+
+#include <sqlite3.h>
+
+#include <stdexcept>
+#include <string>
+
+// Cada migração leva o banco de uma versão para a seguinte. O sync_schema()
+// do sqlite_orm só sabe criar o que falta (tabelas, colunas e índices), então
+// transformações de dados ficam aqui, divididas entre o que precisa rodar
+// antes dele (com o esquema antigo) e depois dele (com o esquema novo)
+struct Migration {
+  int version;
+  const char* before_sync;
+  const char* after_sync;
+
+  // Versão mínima do banco para que a migração rode. Bancos mais antigos
+  // chegam ao mesmo resultado por uma migração anterior que recria a tabela
+  int since = 0;
+};
+
+inline constexpr Migration kMigrations[] = {
+    // v1: índices secundários. O índice único em doador.telefone exige que
+    // doadores repetidos sejam unificados no de menor id antes de ser criado
+    {1,
+     "UPDATE doacao SET id_doador = ("
+     "  SELECT MIN(outro.id) FROM doador atual"
+     "  JOIN doador outro ON outro.telefone = atual.telefone"
+     "  WHERE atual.id = doacao.id_doador)"
+     " WHERE id_doador IN (SELECT id FROM doador);"
+     "DELETE FROM doador WHERE id NOT IN ("
+     "  SELECT MIN(id) FROM doador GROUP BY telefone);",
+     nullptr},
+
+    // v2: doacao.data passa de texto "DD/MM/YYYY" para o inteiro AAAAMMDD. A
+    // tabela antiga é renomeada, o sync_schema() cria a nova, e as linhas são
+    // copiadas convertendo a data. Os índices da tabela antiga são removidos
+    // antes para que os da nova possam ser criados com os mesmos nomes.
+    // A cópia já converte tamanho, condicao e status como a v4
+    {2,
+     "DROP INDEX IF EXISTS idx_doacao_id_doador;"
+     "DROP INDEX IF EXISTS idx_doacao_status;"
+     "DROP INDEX IF EXISTS idx_doacao_data;"
+     "ALTER TABLE doacao RENAME TO doacao_v1;",
+     "INSERT INTO doacao"
+     "  (id, data, tamanho, condicao, status, descricao, id_doador)"
+     " SELECT id,"
+     "  CAST(substr(data, 7, 4) || substr(data, 4, 2) || substr(data, 1, 2)"
+     "   AS INTEGER),"
+     "  CASE tamanho WHEN 'P' THEN 0 WHEN 'M' THEN 1 WHEN 'G' THEN 2"
+     "   WHEN 'GG' THEN 3 WHEN 'XG' THEN 4 ELSE 1 END,"
+     "  CASE condicao WHEN 'Novo' THEN 0 WHEN 'Semi-novo' THEN 1"
+     "   WHEN 'Usado' THEN 2 ELSE 0 END,"
+     "  CASE status WHEN 'Doado' THEN 1 ELSE 0 END,"
+     "  descricao, id_doador"
+     " FROM doacao_v1;"
+     "UPDATE sqlite_sequence SET seq = MAX(seq, COALESCE("
+     "  (SELECT seq FROM sqlite_sequence WHERE name = 'doacao_v1'), 0))"
+     " WHERE name = 'doacao';"
+     "DROP TABLE doacao_v1;"},
+
+    // v3: índices de busca (kSearchSchema), preenchidos com as linhas que já
+    // existem no banco
+    {3, nullptr,
+     "INSERT INTO doador_fts(doador_fts) VALUES ('rebuild');"
+     "INSERT INTO doacao_fts(doacao_fts) VALUES ('rebuild');"},
+
+    // v4: tamanho, condicao e status passam de texto para o código inteiro
+    // dos enums de storage.hpp. A tabela é recriada como na v2; os triggers
+    // da busca são removidos junto com os índices, senão acompanhariam a
+    // tabela renomeada, e o índice de texto é reconstruído no final. Bancos
+    // anteriores à v2 já foram convertidos por ela
+    {4,
+     "DROP INDEX IF EXISTS idx_doacao_id_doador;"
+     "DROP INDEX IF EXISTS idx_doacao_status;"
+     "DROP INDEX IF EXISTS idx_doacao_data;"
+     "DROP INDEX IF EXISTS idx_doacao_tamanho;"
+     "DROP INDEX IF EXISTS idx_doacao_condicao;"
+     "DROP TRIGGER IF EXISTS doacao_fts_insert;"
+     "DROP TRIGGER IF EXISTS doacao_fts_delete;"
+     "DROP TRIGGER IF EXISTS doacao_fts_update;"
+     "ALTER TABLE doacao RENAME TO doacao_v3;",
+     "INSERT INTO doacao"
+     "  (id, data, tamanho, condicao, status, descricao, id_doador)"
+     " SELECT id, data,"
+     "  CASE tamanho WHEN 'P' THEN 0 WHEN 'M' THEN 1 WHEN 'G' THEN 2"
+     "   WHEN 'GG' THEN 3 WHEN 'XG' THEN 4 ELSE 1 END,"
+     "  CASE condicao WHEN 'Novo' THEN 0 WHEN 'Semi-novo' THEN 1"
+     "   WHEN 'Usado' THEN 2 ELSE 0 END,"
+     "  CASE status WHEN 'Doado' THEN 1 ELSE 0 END,"
+     "  descricao, id_doador"
+     " FROM doacao_v3;"
+     "UPDATE sqlite_sequence SET seq = MAX(seq, COALESCE("
+     "  (SELECT seq FROM sqlite_sequence WHERE name = 'doacao_v3'), 0))"
+     " WHERE name = 'doacao';"
+     "DROP TABLE doacao_v3;"
+     "INSERT INTO doacao_fts(doacao_fts) VALUES ('rebuild');",
+     2},
+
+    // v5: tabelas estacao, alteracao e replica da sincronização entre
+    // estações, criadas vazias pelo sync_schema()
+    {5, nullptr, nullptr},
+
+    // v6: doadores passam a ser encontrados pela chave numérica do telefone
+    // (phoneKey() de formatting.hpp), com índice único no lugar do de
+    // doador.telefone. A chave é calculada em SQL como lá, e telefones com e
+    // sem o 9 dos celulares que viram a mesma chave são unificados no doador
+    // de menor id, como na v1
+    {6, "DROP INDEX IF EXISTS idx_doador_telefone;",
+     "CREATE TEMP TABLE chave_telefone AS"
+     " SELECT id, CASE"
+     "  WHEN digitos GLOB '*[^0-9]*' THEN NULL"
+     "  WHEN length(digitos) = 11 THEN CAST(digitos AS INTEGER)"
+     "  WHEN length(digitos) = 10 AND substr(digitos, 3, 1) >= '6' THEN"
+     "   CAST(substr(digitos, 1, 2) || '9' || substr(digitos, 3) AS INTEGER)"
+     "  WHEN length(digitos) = 10 THEN CAST(digitos AS INTEGER)"
+     "  END AS chave"
+     " FROM (SELECT id, replace(replace(replace(replace(replace(replace("
+     "  telefone, '(', ''), ')', ''), ' ', ''), '-', ''), '.', ''), '+', '')"
+     "  AS digitos FROM doador);"
+     "UPDATE doacao SET id_doador = ("
+     "  SELECT MIN(outro.id) FROM chave_telefone atual"
+     "  JOIN chave_telefone outro ON outro.chave = atual.chave"
+     "  WHERE atual.id = doacao.id_doador)"
+     " WHERE id_doador IN (SELECT id FROM chave_telefone"
+     "  WHERE chave IS NOT NULL);"
+     "DELETE FROM doador WHERE id IN ("
+     "  SELECT atual.id FROM chave_telefone atual"
+     "  JOIN chave_telefone outro ON outro.chave = atual.chave"
+     "  WHERE outro.id < atual.id);"
+     "UPDATE doador SET telefone_chave = ("
+     "  SELECT chave FROM chave_telefone WHERE chave_telefone.id = doador.id);"
+     "DROP TABLE chave_telefone;"},
+
+    // v7: tabela rascunho, do salvamento automático do formulário de
+    // cadastro, criada vazia pelo sync_schema()
+    {7, nullptr, nullptr},
+};
+
+// Índices de texto completo das buscas por nome, telefone e descrição. São
+// tabelas FTS5 de conteúdo externo com o tokenizador trigram, que encontra
+// qualquer trecho de pelo menos 3 caracteres, e são mantidas pelos triggers
+// a cada inserção, alteração e remoção.
+//
+// Como o sqlite_orm não conhece essas tabelas, elas são criadas aqui depois
+// de todo sync_schema(). Se ele recriar doador ou doacao, os triggers somem
+// junto e são criados de novo, mas a migração responsável precisa reconstruir
+// o índice com 'rebuild'
+inline constexpr const char* kSearchSchema =
+    "CREATE VIRTUAL TABLE IF NOT EXISTS doador_fts USING fts5("
+    "  nome, telefone, content = 'doador', content_rowid = 'id',"
+    "  tokenize = 'trigram');"
+    "CREATE TRIGGER IF NOT EXISTS doador_fts_insert AFTER INSERT ON doador"
+    " BEGIN"
+    "  INSERT INTO doador_fts (rowid, nome, telefone)"
+    "   VALUES (new.id, new.nome, new.telefone);"
+    " END;"
+    "CREATE TRIGGER IF NOT EXISTS doador_fts_delete AFTER DELETE ON doador"
+    " BEGIN"
+    "  INSERT INTO doador_fts (doador_fts, rowid, nome, telefone)"
+    "   VALUES ('delete', old.id, old.nome, old.telefone);"
+    " END;"
+    "CREATE TRIGGER IF NOT EXISTS doador_fts_update"
+    " AFTER UPDATE OF id, nome, telefone ON doador"
+    " BEGIN"
+    "  INSERT INTO doador_fts (doador_fts, rowid, nome, telefone)"
+    "   VALUES ('delete', old.id, old.nome, old.telefone);"
+    "  INSERT INTO doador_fts (rowid, nome, telefone)"
+    "   VALUES (new.id, new.nome, new.telefone);"
+    " END;"
+
+    "CREATE VIRTUAL TABLE IF NOT EXISTS doacao_fts USING fts5("
+    "  descricao, content = 'doacao', content_rowid = 'id',"
+    "  tokenize = 'trigram');"
+    "CREATE TRIGGER IF NOT EXISTS doacao_fts_insert AFTER INSERT ON doacao"
+    " BEGIN"
+    "  INSERT INTO doacao_fts (rowid, descricao)"
+    "   VALUES (new.id, new.descricao);"
+    " END;"
+    "CREATE TRIGGER IF NOT EXISTS doacao_fts_delete AFTER DELETE ON doacao"
+    " BEGIN"
+    "  INSERT INTO doacao_fts (doacao_fts, rowid, descricao)"
+    "   VALUES ('delete', old.id, old.descricao);"
+    " END;"
+    "CREATE TRIGGER IF NOT EXISTS doacao_fts_update"
+    " AFTER UPDATE OF id, descricao ON doacao"
+    " BEGIN"
+    "  INSERT INTO doacao_fts (doacao_fts, rowid, descricao)"
+    "   VALUES ('delete', old.id, old.descricao);"
+    "  INSERT INTO doacao_fts (rowid, descricao)"
+    "   VALUES (new.id, new.descricao);"
+    " END;";
+
+// Versão do esquema declarado em initStorage(), gravada em PRAGMA user_version
+constexpr int kSchemaVersion =
+    kMigrations[sizeof(kMigrations) / sizeof(kMigrations[0]) - 1].version;
+
+// Aplica as migrações pendentes usando uma conexão própria, aberta apenas
+// durante a inicialização
+class Migrator {
+ public:
+  explicit Migrator(const std::string& path) {
+    if (sqlite3_open(path.c_str(), &db) != SQLITE_OK) {
+      std::string message = sqlite3_errmsg(db);
+      sqlite3_close(db);
+
+      throw std::runtime_error("Erro ao abrir o banco: " + message);
+    }
+
+    version = QueryInt("PRAGMA user_version;");
+
+    // A tabela renomeada pela v2 ou pela v4 só existe entre o BeforeSync()
+    // e o AfterSync(). Se ela ficou no banco, uma migração foi interrompida
+    // (o aplicativo fechou, ou o sync_schema() ou o AfterSync() falharam)
+    // depois de a parte anterior ser gravada, e a cópia das doações precisa
+    // ser retomada, e não o banco tratado como novo
+    interrupted = QueryInt(
+                      "SELECT COUNT(*) FROM sqlite_master WHERE type = 'table'"
+                      " AND name IN ('doacao_v1', 'doacao_v3');") > 0;
+
+    // Um banco sem a tabela doacao acabou de ser criado, e o sync_schema()
+    // já vai criá-lo na versão atual
+    fresh = !interrupted &&
+            QueryInt(
+                "SELECT COUNT(*) FROM sqlite_master "
+                "WHERE type = 'table' AND name = 'doacao';") == 0;
+  }
+
+  ~Migrator() { sqlite3_close(db); }
+
+  Migrator(const Migrator&) = delete;
+  Migrator& operator=(const Migrator&) = delete;
+
+  // O banco já está na versão atual, e nem as migrações nem o sync_schema()
+  // precisam rodar
+  bool Current() const { return !fresh && version == kSchemaVersion; }
+
+  // Deve ser chamado antes do sync_schema(). As partes anteriores de todas
+  // as migrações pendentes são gravadas juntas, então uma migração
+  // interrompida já as aplicou e segue direto para o AfterSync()
+  void BeforeSync() {
+    if (fresh || interrupted) return;
+
+    Exec("BEGIN;");
+    for (const Migration& migration : kMigrations) {
+      if (Pending(migration) && migration.before_sync)
+        Exec(migration.before_sync);
+    }
+    Exec("COMMIT;");
+  }
+
+  // Deve ser chamado depois do sync_schema(), e marca o banco como atualizado
+  void AfterSync() {
+    Exec("BEGIN;");
+    Exec(kSearchSchema);
+
+    if (!fresh) {
+      for (const Migration& migration : kMigrations) {
+        if (Pending(migration) && migration.after_sync)
+          Exec(migration.after_sync);
+      }
+    }
+
+    Exec(("PRAGMA user_version = " + std::to_string(kSchemaVersion) + ";")
+             .c_str());
+    Exec("COMMIT;");
+
+    version = kSchemaVersion;
+  }
+
+ private:
+  bool Pending(const Migration& migration) const {
+    return migration.version > version && version >= migration.since;
+  }
+
+  void Exec(const char* sql) {
+    char* error = nullptr;
+    if (sqlite3_exec(db, sql, nullptr, nullptr, &error) != SQLITE_OK) {
+      std::string message = error ? error : "erro desconhecido";
+      sqlite3_free(error);
+      sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+
+      throw std::runtime_error("Erro ao migrar o banco: " + message);
+    }
+  }
+
+  int QueryInt(const char* sql) {
+    sqlite3_stmt* stmt = nullptr;
+    int value = 0;
+
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW)
+      value = sqlite3_column_int(stmt, 0);
+
+    sqlite3_finalize(stmt);
+    return value;
+  }
+
+  sqlite3* db = nullptr;
+  int version = 0;
+  bool fresh = false;
+  bool interrupted = false;
+};
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+// Mapa telefone -> id do doador, com a chave numérica de phoneKey(). É uma
+// tabela de endereçamento aberto com sondagem linear: chaves e ids ficam em
+// um único vetor, sem um nó alocado por doador, e uma busca costuma ler uma
+// única linha de cache. A chave 0 (telefone inválido) marca as posições
+// vazias. Doadores não são removidos, então a tabela não precisa de lápides.
+class PhoneIndex {
+ public:
+  PhoneIndex() { Rehash(kMinCapacity); }
+
+  void Clear() {
+    posicoes.clear();
+    tamanho = 0;
+    Rehash(kMinCapacity);
+  }
+
+  // Prepara a tabela para n doadores, sem crescer durante a carga
+  void Reserve(size_t n) {
+    size_t capacidade = kMinCapacity;
+    while (capacidade * kMaxLoad < n * 4) capacidade *= 2;
+
+    if (capacidade > posicoes.size()) Rehash(capacidade);
+  }
+
+  // Insere o telefone, ou troca o id caso ele já esteja no mapa
+  void Insert(long long chave, int id) {
+    if (chave == 0) return;
+
+    if ((tamanho + 1) * 4 > posicoes.size() * kMaxLoad)
+      Rehash(posicoes.size() * 2);
+
+    Posicao& posicao = posicoes[Slot(chave)];
+    if (posicao.chave == 0) {
+      posicao.chave = chave;
+      tamanho++;
+    }
+
+    posicao.id = id;
+  }
+
+  std::optional<int> Find(long long chave) const {
+    if (chave == 0) return std::nullopt;
+
+    const Posicao& posicao = posicoes[Slot(chave)];
+    if (posicao.chave == 0) return std::nullopt;
+
+    return posicao.id;
+  }
+
+  size_t Size() const { return tamanho; }
+
+ private:
+  static constexpr size_t kMinCapacity = 64;
+
+  // Ocupação máxima, em quartos da capacidade
+  static constexpr size_t kMaxLoad = 3;
+
+  struct Posicao {
+    long long chave = 0;
+    int id = 0;
+  };
+
+  // Posição da chave, ou a posição vazia onde ela entraria
+  size_t Slot(long long chave) const {
+    const size_t mascara = posicoes.size() - 1;
+
+    // Hash multiplicativo de Fibonacci: os bits altos do produto dependem
+    // de todos os dígitos, e não só dos do DDD, que se repetem muito
+    size_t i = static_cast<size_t>(
+                   (static_cast<uint64_t>(chave) * 0x9E3779B97F4A7C15ull) >>
+                   deslocamento) &
+               mascara;
+
+    while (posicoes[i].chave != 0 && posicoes[i].chave != chave)
+      i = (i + 1) & mascara;
+
+    return i;
+  }
+
+  void Rehash(size_t capacidade) {
+    std::vector<Posicao> antigas(capacidade);
+    antigas.swap(posicoes);
+
+    deslocamento = 64;
+    for (size_t c = capacidade; c > 1; c >>= 1) deslocamento--;
+
+    for (const Posicao& posicao : antigas) {
+      if (posicao.chave != 0) posicoes[Slot(posicao.chave)] = posicao;
+    }
+  }
+
+  std::vector<Posicao> posicoes;
+  size_t tamanho = 0;
+  int deslocamento = 64;
+};
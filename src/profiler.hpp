@@ -0,0 +1,327 @@
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "imgui.h"
+
+// Medições do laço principal e das consultas ao banco feitas pela interface.
+// As fases de cada quadro e as consultas são sempre medidas, o que custa
+// algumas leituras do relógio por quadro; a janela com os resultados é
+// aberta e fechada com F12.
+//
+// Com a gravação ligada, cada fase e cada consulta também vira um evento de
+// um trace no formato do chrome://tracing (e do Perfetto), exportado pela
+// própria janela. Usado apenas pelo thread da interface.
+class Profiler {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  // Fases do laço principal, na ordem em que acontecem
+  enum Phase { kEvents, kNewFrame, kUpdate, kRender, kSwap, kPhaseCount };
+
+  // Quantidade de quadros mantidos no histórico
+  static constexpr int kHistory = 240;
+
+  // Limite de eventos do trace, cerca de 40 MB
+  static constexpr size_t kMaxTraceEvents = 1 << 20;
+
+  Profiler() : origem(Clock::now()), marca_etapa(origem) {}
+
+  void BeginFrame() {
+    marca = Clock::now();
+    consultas_quadro = 0;
+    linhas_quadro = 0;
+  }
+
+  // Encerra a fase que começou no fim da anterior (ou em BeginFrame)
+  void EndPhase(Phase phase) {
+    const auto agora = Clock::now();
+    fases[phase] = Milliseconds(marca, agora);
+
+    Trace(kPhaseNames[phase], "quadro", marca, agora, 0);
+    marca = agora;
+  }
+
+  void EndFrame() {
+    // A espera por eventos no modo de economia de energia não conta como
+    // trabalho do quadro
+    double trabalho = 0;
+    for (int i = kNewFrame; i < kPhaseCount; i++) trabalho += fases[i];
+
+    historico_quadros[posicao] = static_cast<float>(trabalho);
+    historico_linhas[posicao] = static_cast<float>(linhas_quadro);
+    posicao = (posicao + 1) % kHistory;
+    quadros++;
+
+    consultas_ultimo_quadro = consultas_quadro;
+  }
+
+  // Executa fn, que faz uma consulta ao banco, e registra quanto tempo levou e
+  // quantas linhas devolveu. nome precisa ser uma string literal
+  template <typename Fn>
+  auto Query(const char* nome, Fn&& fn) {
+    const auto inicio = Clock::now();
+
+    if constexpr (std::is_void_v<decltype(fn())>) {
+      fn();
+      RecordQuery(nome, inicio, Clock::now(), 0);
+    } else {
+      auto result = fn();
+      RecordQuery(nome, inicio, Clock::now(), Rows(result));
+
+      return result;
+    }
+  }
+
+  // Registra uma consulta medida em outro thread (como as do thread do
+  // banco), mas informada por este. nome precisa ser uma string literal
+  void RecordQuery(const char* nome, Clock::time_point inicio,
+                   Clock::time_point fim, size_t linhas) {
+    const double ms = Milliseconds(inicio, fim);
+
+    QueryStats& stats = consultas[nome];
+    stats.chamadas++;
+    stats.linhas += linhas;
+    stats.total_ms += ms;
+    stats.maximo_ms = std::max(stats.maximo_ms, ms);
+    stats.ultima_ms = ms;
+
+    consultas_quadro++;
+    linhas_quadro += linhas;
+
+    Trace(nome, "sqlite", inicio, fim, linhas);
+  }
+
+  // Encerra uma etapa da inicialização, que começou no fim da anterior (ou na
+  // criação do profiler). nome precisa ser uma string literal
+  void EndStartupStep(const char* nome) {
+    const auto agora = Clock::now();
+    etapas.push_back({nome, Milliseconds(marca_etapa, agora)});
+    marca_etapa = agora;
+  }
+
+  // Imprime as etapas da inicialização na saída de erro
+  void LogStartup() const {
+    double total = 0;
+    for (const auto& [nome, ms] : etapas) {
+      fprintf(stderr, "Inicialização: %-24s %8.1f ms\n", nome, ms);
+      total += ms;
+    }
+
+    fprintf(stderr, "Inicialização: %-24s %8.1f ms\n", "total", total);
+  }
+
+  // Janela com o histórico dos quadros e as estatísticas das consultas
+  void Draw() {
+    if (ImGui::IsKeyPressed(ImGuiKey_F12, false)) visivel = !visivel;
+    if (!visivel) return;
+
+    ImGui::SetNextWindowSize(ImVec2(900, 700), ImGuiCond_FirstUseEver);
+    if (!ImGui::Begin("Profiler", &visivel)) {
+      ImGui::End();
+      return;
+    }
+
+    const int ultimo = (posicao + kHistory - 1) % kHistory;
+    const int amostras =
+        static_cast<int>(std::min<long long>(quadros, kHistory));
+
+    float maximo = 0;
+    for (int i = 0; i < amostras; i++)
+      maximo = std::max(maximo, historico_quadros[i]);
+
+    char legenda[64];
+    snprintf(legenda, sizeof(legenda), "%.2f ms (máx. %.2f ms)",
+             historico_quadros[ultimo], maximo);
+    ImGui::Text("Tempo de cada quadro, sem a espera por eventos");
+    ImGui::PlotLines("##quadros", historico_quadros, kHistory, posicao,
+                     legenda, 0, std::max(maximo, 16.7f),
+                     ImVec2(-1, 120));
+
+    ImGui::Text("Linhas lidas do banco por quadro");
+    snprintf(legenda, sizeof(legenda), "%.0f", historico_linhas[ultimo]);
+    ImGui::PlotHistogram("##linhas", historico_linhas, kHistory, posicao,
+                         legenda, 0, FLT_MAX, ImVec2(-1, 80));
+
+    ImGui::Text("Eventos %.2f ms | NewFrame %.2f ms | Update %.2f ms | "
+                "Render %.2f ms | Swap %.2f ms",
+                fases[kEvents], fases[kNewFrame], fases[kUpdate],
+                fases[kRender], fases[kSwap]);
+    ImGui::Text("%zu consultas no último quadro", consultas_ultimo_quadro);
+
+    if (ImGui::TreeNode("Inicialização")) {
+      for (const auto& [nome, ms] : etapas)
+        ImGui::Text("%s: %.1f ms", nome, ms);
+      ImGui::TreePop();
+    }
+
+    ImGui::Separator();
+
+    if (ImGui::BeginTable("##consultas", 6,
+                          ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+      ImGui::TableSetupColumn("Consulta");
+      ImGui::TableSetupColumn("Chamadas");
+      ImGui::TableSetupColumn("Média (ms)");
+      ImGui::TableSetupColumn("Máx. (ms)");
+      ImGui::TableSetupColumn("Última (ms)");
+      ImGui::TableSetupColumn("Linhas");
+      ImGui::TableHeadersRow();
+
+      for (const auto& [nome, stats] : consultas) {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted(nome);
+        ImGui::TableNextColumn();
+        ImGui::Text("%zu", stats.chamadas);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", stats.total_ms / stats.chamadas);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", stats.maximo_ms);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", stats.ultima_ms);
+        ImGui::TableNextColumn();
+        ImGui::Text("%zu", stats.linhas);
+      }
+
+      ImGui::EndTable();
+    }
+
+    if (ImGui::Button("Zerar")) consultas.clear();
+
+    ImGui::Separator();
+
+    if (ImGui::Checkbox("Gravar trace", &gravando) && gravando)
+      eventos.clear();
+    ImGui::SameLine();
+    ImGui::Text("%zu eventos", eventos.size());
+
+    ImGui::InputText("##arquivo", arquivo, sizeof(arquivo));
+    ImGui::SameLine();
+    if (ImGui::Button("Exportar")) {
+      snprintf(mensagem, sizeof(mensagem), "%s",
+               ExportChromeTrace(arquivo)
+                   ? "Trace exportado"
+                   : "Não foi possível gravar o arquivo");
+    }
+    if (mensagem[0]) ImGui::TextUnformatted(mensagem);
+
+    ImGui::End();
+  }
+
+  // Grava os eventos no formato JSON do chrome://tracing
+  bool ExportChromeTrace(const char* path) const {
+    FILE* file = fopen(path, "w");
+    if (!file) return false;
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+    for (size_t i = 0; i < eventos.size(); i++) {
+      const Event& evento = eventos[i];
+
+      fprintf(file,
+              "%s\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%lld,"
+              "\"dur\":%lld,\"pid\":1,\"tid\":1,\"args\":{\"linhas\":%zu}}",
+              i ? "," : "", evento.nome, evento.categoria, evento.inicio_us,
+              evento.duracao_us, evento.linhas);
+    }
+
+    fprintf(file, "\n]}\n");
+    return fclose(file) == 0;
+  }
+
+ private:
+  static constexpr const char* kPhaseNames[kPhaseCount] = {
+      "Eventos", "NewFrame", "Update", "Render", "Swap"};
+
+  struct QueryStats {
+    size_t chamadas = 0;
+    size_t linhas = 0;
+    double total_ms = 0;
+    double maximo_ms = 0;
+    double ultima_ms = 0;
+  };
+
+  struct Event {
+    const char* nome;
+    const char* categoria;
+    long long inicio_us;
+    long long duracao_us;
+    size_t linhas;
+  };
+
+  // Resultados com size() contam como linhas lidas, assim como um size_t
+  // devolvido com a quantidade de linhas
+  template <typename T, typename = void>
+  struct HasSize : std::false_type {};
+
+  template <typename T>
+  struct HasSize<T, std::void_t<decltype(std::declval<const T&>().size())>>
+      : std::true_type {};
+
+  template <typename T>
+  static size_t Rows(const T& result) {
+    if constexpr (HasSize<T>::value) {
+      return result.size();
+    } else if constexpr (std::is_same_v<T, size_t>) {
+      return result;
+    } else {
+      return 0;
+    }
+  }
+
+  static double Milliseconds(Clock::time_point inicio, Clock::time_point fim) {
+    return std::chrono::duration<double, std::milli>(fim - inicio).count();
+  }
+
+  void Trace(const char* nome, const char* categoria, Clock::time_point inicio,
+             Clock::time_point fim, size_t linhas) {
+    if (!gravando || eventos.size() >= kMaxTraceEvents) return;
+
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+
+    eventos.push_back(Event{
+        nome, categoria,
+        duration_cast<microseconds>(inicio - origem).count(),
+        duration_cast<microseconds>(fim - inicio).count(), linhas});
+  }
+
+  bool visivel = false;
+  bool gravando = false;
+  char arquivo[256] = "trace.json";
+  char mensagem[64] = "";
+
+  Clock::time_point origem;
+  Clock::time_point marca;
+
+  // Etapas da inicialização, com a duração de cada uma em ms
+  Clock::time_point marca_etapa;
+  std::vector<std::pair<const char*, double>> etapas;
+
+  double fases[kPhaseCount] = {};
+  float historico_quadros[kHistory] = {};
+  float historico_linhas[kHistory] = {};
+  int posicao = 0;
+  long long quadros = 0;
+
+  size_t consultas_quadro = 0;
+  size_t consultas_ultimo_quadro = 0;
+  size_t linhas_quadro = 0;
+
+  // Ordenado pelo nome, para que a tabela não mude de ordem
+  std::map<const char*, QueryStats, bool (*)(const char*, const char*)>
+      consultas{[](const char* a, const char* b) {
+        return std::strcmp(a, b) < 0;
+      }};
+
+  std::vector<Event> eventos;
+};
@@ -0,0 +1,394 @@
+#pragma once
+
+#include <sqlite3.h>
+
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "formatting.hpp"
+#include "storage.hpp"
+
+// Statement do SQLite preparado uma única vez e reaproveitado. O sqlite_orm
+// prepara novamente cada consulta a cada chamada, o que domina o custo das
+// escritas pequenas e repetidas
+class Statement {
+ public:
+  Statement(sqlite3* db, const char* sql) : db(db) {
+    if (sqlite3_prepare_v3(db, sql, -1, SQLITE_PREPARE_PERSISTENT, &stmt,
+                           nullptr) != SQLITE_OK)
+      Fail();
+  }
+
+  ~Statement() { sqlite3_finalize(stmt); }
+
+  Statement(const Statement&) = delete;
+  Statement& operator=(const Statement&) = delete;
+
+  // Os textos precisam continuar válidos até Reset()
+  Statement& Bind(int index, const std::string& value) {
+    Check(sqlite3_bind_text(stmt, index, value.data(),
+                            static_cast<int>(value.size()), SQLITE_STATIC));
+    return *this;
+  }
+
+  // Cópia própria do texto, para valores temporários
+  Statement& BindCopy(int index, const std::string& value) {
+    Check(sqlite3_bind_text(stmt, index, value.data(),
+                            static_cast<int>(value.size()), SQLITE_TRANSIENT));
+    return *this;
+  }
+
+  Statement& Bind(int index, int value) {
+    Check(sqlite3_bind_int(stmt, index, value));
+    return *this;
+  }
+
+  Statement& Bind(int index, long long value) {
+    Check(sqlite3_bind_int64(stmt, index, value));
+    return *this;
+  }
+
+  Statement& BindNull(int index) {
+    Check(sqlite3_bind_null(stmt, index));
+    return *this;
+  }
+
+  // Avança para a próxima linha do resultado, devolvendo false no fim
+  bool Step() {
+    const int result = sqlite3_step(stmt);
+    if (result == SQLITE_ROW) return true;
+    if (result != SQLITE_DONE) Fail();
+
+    return false;
+  }
+
+  int ColumnInt(int index) const { return sqlite3_column_int(stmt, index); }
+
+  long long ColumnInt64(int index) const {
+    return sqlite3_column_int64(stmt, index);
+  }
+
+  std::string ColumnText(int index) const {
+    const auto* text =
+        reinterpret_cast<const char*>(sqlite3_column_text(stmt, index));
+    return text ? std::string(text, sqlite3_column_bytes(stmt, index))
+                : std::string();
+  }
+
+  // Texto da coluna sem cópia, válido só até o próximo Step() ou Reset()
+  std::string_view ColumnView(int index) const {
+    const auto* text =
+        reinterpret_cast<const char*>(sqlite3_column_text(stmt, index));
+    return text ? std::string_view(text, sqlite3_column_bytes(stmt, index))
+                : std::string_view();
+  }
+
+  // Posição do parâmetro nomeado (":nome"), ou 0 se a consulta não o usa
+  int Parameter(const char* name) const {
+    return sqlite3_bind_parameter_index(stmt, name);
+  }
+
+  // Deixa o statement pronto para a próxima execução
+  void Reset() {
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+  }
+
+ private:
+  void Check(int result) {
+    if (result != SQLITE_OK) Fail();
+  }
+
+  [[noreturn]] void Fail() {
+    const std::string message = sqlite3_errmsg(db);
+    if (stmt) sqlite3_reset(stmt);
+
+    throw std::runtime_error(message);
+  }
+
+  sqlite3* db;
+  sqlite3_stmt* stmt = nullptr;
+};
+
+// Consultas executadas com frequência pelo thread de escrita, pela importação
+// e pelas buscas da interface, preparadas sobre uma conexão aberta com
+// openForever()
+class Queries {
+ public:
+  // O índice trigram só encontra trechos com pelo menos 3 caracteres
+  static constexpr int kMinSearchLength = 3;
+
+  // As buscas de doadores param no primeiro lote de resultados, o que as
+  // mantém rápidas mesmo quando o texto digitado ainda é curto e aparece em
+  // muitas linhas
+  static constexpr int kMaxSearchResults = 1000;
+
+  explicit Queries(sqlite3* db)
+      : db(db),
+        find_donor(db, "SELECT id FROM doador WHERE telefone_chave = ?"),
+        insert_donor(db,
+                     "INSERT INTO doador (nome, telefone, telefone_chave)"
+                     " VALUES (?, ?, ?)"),
+        insert_donation(db,
+                        "INSERT INTO doacao (data, tamanho, condicao, status,"
+                        " descricao, id_doador) VALUES (?, ?, ?, ?, ?, ?)"),
+        update_status(db, "UPDATE doacao SET status = ? WHERE id = ?"),
+        remove_donation(db, "DELETE FROM doacao WHERE id = ?"),
+        update_statuses(db,
+                        "UPDATE doacao SET status = ?1"
+                        " WHERE id IN (SELECT value FROM json_each(?2))"
+                        " AND status != ?1 RETURNING id"),
+        remove_donations(db,
+                         "DELETE FROM doacao"
+                         " WHERE id IN (SELECT value FROM json_each(?))"
+                         " RETURNING id, id_doador"),
+        search_donors(db,
+                      "SELECT rowid FROM doador_fts WHERE doador_fts MATCH ?"
+                      " ORDER BY rowid LIMIT ?"),
+        tick(db,
+             "UPDATE estacao SET relogio = relogio + 1 WHERE local = 1"
+             " RETURNING id, relogio"),
+        log_change(db,
+                   "INSERT INTO alteracao (estacao, relogio, operacao, origem,"
+                   " doacao, data, tamanho, condicao, status, descricao, nome,"
+                   " telefone) VALUES (?1, ?2, ?3,"
+                   " COALESCE((SELECT origem FROM replica WHERE doacao = ?4),"
+                   "  ?1),"
+                   " COALESCE((SELECT doacao_origem FROM replica"
+                   "  WHERE doacao = ?4), ?4),"
+                   " ?5, ?6, ?7, ?8, ?9, ?10, ?11)"),
+        save_draft(db,
+                   "INSERT OR REPLACE INTO rascunho (id, nome, telefone, data,"
+                   " tamanho, condicao, descricao) VALUES (1, ?, ?, ?, ?, ?, ?)"),
+        clear_draft(db, "DELETE FROM rascunho") {}
+
+  sqlite3* Connection() const { return db; }
+
+  // Quantidade de caracteres UTF-8 do texto
+  static int SearchLength(const char* texto) {
+    int total = 0;
+    for (const char* c = texto; *c; c++) {
+      if ((*c & 0xC0) != 0x80) total++;
+    }
+
+    return total;
+  }
+
+  // Encontra o doador pela chave do telefone, então números com e sem o 9
+  // dos celulares levam ao mesmo doador
+  std::optional<int> FindDonorByPhone(const std::string& telefone) {
+    const long long chave = phoneKey(telefone.c_str());
+    if (chave == 0) return std::nullopt;
+
+    find_donor.Bind(1, chave);
+
+    std::optional<int> id;
+    if (find_donor.Step()) id = find_donor.ColumnInt(0);
+
+    find_donor.Reset();
+    return id;
+  }
+
+  int InsertDonor(const Doador& doador) {
+    insert_donor.Bind(1, doador.nome).Bind(2, doador.telefone);
+
+    const long long chave = phoneKey(doador.telefone.c_str());
+    if (chave != 0) {
+      insert_donor.Bind(3, chave);
+    } else {
+      insert_donor.BindNull(3);
+    }
+
+    return Insert(insert_donor);
+  }
+
+  int InsertDonation(const Doacao& doacao) {
+    insert_donation.Bind(1, doacao.data)
+        .Bind(2, static_cast<int>(doacao.tamanho))
+        .Bind(3, static_cast<int>(doacao.condicao))
+        .Bind(4, static_cast<int>(doacao.status))
+        .Bind(5, doacao.descricao);
+
+    if (doacao.id_doador) {
+      insert_donation.Bind(6, *doacao.id_doador);
+    } else {
+      insert_donation.BindNull(6);
+    }
+
+    return Insert(insert_donation);
+  }
+
+  void UpdateStatus(int id, Status status) {
+    update_status.Bind(1, static_cast<int>(status)).Bind(2, id);
+    update_status.Step();
+    update_status.Reset();
+  }
+
+  void RemoveDonation(int id) {
+    remove_donation.Bind(1, id);
+    remove_donation.Step();
+    remove_donation.Reset();
+  }
+
+  // Alterações em lote da aba de estoque, cada uma um único comando com a
+  // lista de ids passada como um array JSON. Devolvem apenas as doações que
+  // de fato mudaram, na ordem em que o SQLite as alterou
+
+  std::vector<int> UpdateStatuses(const std::vector<int>& ids, Status status) {
+    const std::string lista = IdList(ids);
+    update_statuses.Bind(1, static_cast<int>(status)).Bind(2, lista);
+
+    return Ids(update_statuses);
+  }
+
+  // Pares (id, id_doador) das doações removidas
+  std::vector<std::pair<int, int>> RemoveDonations(
+      const std::vector<int>& ids) {
+    const std::string lista = IdList(ids);
+    remove_donations.Bind(1, lista);
+
+    std::vector<std::pair<int, int>> removidas;
+    while (remove_donations.Step()) {
+      removidas.emplace_back(remove_donations.ColumnInt(0),
+                             remove_donations.ColumnInt(1));
+    }
+    remove_donations.Reset();
+
+    return removidas;
+  }
+
+  // Registro de alterações lido pelas outras estações. Cada escrita feita
+  // pelo aplicativo registra a sua na mesma transação, com o próximo valor
+  // do relógio da estação local
+
+  // O doador vai junto, já que a outra estação o encontra pelo telefone
+  void LogInsert(int id, const Doacao& doacao, const std::string& nome,
+                 const std::string& telefone) {
+    Log(Operacao::kInserir, id)
+        .Bind(5, doacao.data)
+        .Bind(6, static_cast<int>(doacao.tamanho))
+        .Bind(7, static_cast<int>(doacao.condicao))
+        .Bind(8, static_cast<int>(doacao.status))
+        .Bind(9, doacao.descricao)
+        .Bind(10, nome)
+        .Bind(11, telefone);
+    Run(log_change);
+  }
+
+  void LogStatus(int id, Status status) {
+    Log(Operacao::kStatus, id).Bind(8, static_cast<int>(status));
+    Run(log_change);
+  }
+
+  void LogRemove(int id) {
+    Log(Operacao::kRemover, id);
+    Run(log_change);
+  }
+
+  // Grava o rascunho do formulário de cadastro no lugar do anterior
+  void SaveDraft(const Rascunho& rascunho) {
+    save_draft.Bind(1, rascunho.nome)
+        .Bind(2, rascunho.telefone)
+        .Bind(3, rascunho.data)
+        .Bind(4, static_cast<int>(rascunho.tamanho))
+        .Bind(5, static_cast<int>(rascunho.condicao))
+        .Bind(6, rascunho.descricao);
+    Run(save_draft);
+  }
+
+  void ClearDraft() { Run(clear_draft); }
+
+  // Ids dos doadores cujo nome ou telefone contém o texto, em ordem de id
+  std::vector<int> SearchDonors(const std::string& texto) {
+    const std::string frase = Phrase(texto);
+    search_donors.Bind(1, frase).Bind(2, kMaxSearchResults);
+
+    return Ids(search_donors);
+  }
+
+  // O texto vira uma frase entre aspas, para que pontuação e operadores do
+  // FTS5 sejam tratados como texto comum
+  static std::string Phrase(const std::string& texto) {
+    std::string frase = "\"";
+    for (char c : texto) {
+      if (c == '"') frase += '"';
+      frase += c;
+    }
+    frase += '"';
+
+    return frase;
+  }
+
+ private:
+  // Avança o relógio local e liga as colunas comuns a todas as operações.
+  // As demais ficam com valores vazios, já que não aceitam NULL
+  Statement& Log(Operacao operacao, int id) {
+    if (!tick.Step())
+      throw std::runtime_error("Estação local não encontrada");
+    const long long estacao = tick.ColumnInt64(0);
+    const int relogio = tick.ColumnInt(1);
+    tick.Reset();
+
+    static const std::string vazio;
+    return log_change.Bind(1, estacao)
+        .Bind(2, relogio)
+        .Bind(3, static_cast<int>(operacao))
+        .Bind(4, id)
+        .Bind(5, 0)
+        .Bind(6, 0)
+        .Bind(7, 0)
+        .Bind(8, 0)
+        .Bind(9, vazio)
+        .Bind(10, vazio)
+        .Bind(11, vazio);
+  }
+
+  static void Run(Statement& statement) {
+    statement.Step();
+    statement.Reset();
+  }
+
+  int Insert(Statement& statement) {
+    statement.Step();
+    statement.Reset();
+
+    return static_cast<int>(sqlite3_last_insert_rowid(db));
+  }
+
+  static std::string IdList(const std::vector<int>& ids) {
+    std::string lista = "[";
+    for (int id : ids) {
+      if (lista.size() > 1) lista += ',';
+      lista += std::to_string(id);
+    }
+    lista += ']';
+
+    return lista;
+  }
+
+  static std::vector<int> Ids(Statement& statement) {
+    std::vector<int> ids;
+    while (statement.Step()) ids.push_back(statement.ColumnInt(0));
+    statement.Reset();
+
+    return ids;
+  }
+
+  sqlite3* db;
+  Statement find_donor;
+  Statement insert_donor;
+  Statement insert_donation;
+  Statement update_status;
+  Statement remove_donation;
+  Statement update_statuses;
+  Statement remove_donations;
+  Statement search_donors;
+  Statement tick;
+  Statement log_change;
+  Statement save_draft;
+  Statement clear_draft;
+};
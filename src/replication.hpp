@@ -0,0 +1,525 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "queries.hpp"
+#include "storage.hpp"
+
+struct SyncResult {
+  size_t arquivos = 0;
+  size_t alteracoes = 0;  // lidas dos arquivos
+  size_t aplicadas = 0;
+  size_t repetidas = 0;   // já importadas antes
+  size_t ignoradas = 0;   // de doações que não existem mais aqui
+  size_t pendentes = 0;   // de doações que ainda não chegaram aqui
+
+  std::vector<std::string> erros;
+};
+
+// Sincronização entre estações de coleta por arquivos de alterações. Cada
+// estação exporta as alterações do seu registro (a tabela alteracao) que
+// ainda não exportou, e a estação central importa os arquivos de todas.
+//
+// O arquivo é binário: o cabeçalho "AGS1", a estação, o relógio a partir do
+// qual ele foi exportado e a quantidade de alterações, seguidos delas em
+// ordem de relógio. Os inteiros são varints (LEB128), os relógios são
+// gravados como a diferença para o anterior e a origem como a diferença para
+// a estação, então uma alteração de status ocupa poucos bytes.
+//
+// A importação lê todos os arquivos antes, ordena as alterações de cada
+// estação pelo relógio e as aplica em uma única transação. Alterações já
+// importadas são puladas, e uma lacuna no relógio de uma estação interrompe
+// a importação dela, já que as alterações seguintes podem depender das que
+// faltam.
+//
+// Uma estação pode alterar uma doação cadastrada em outra. Se o cadastro
+// ainda não foi aplicado, a estação fica parada nessa alteração e as outras
+// seguem; quando nenhuma avança mais, as paradas continuam pendentes, sem
+// que o relógio da estação passe delas, e são aplicadas quando o arquivo
+// for importado de novo junto com o da estação de origem.
+class Replicator {
+ public:
+  Replicator(Storage& stor, Queries& queries)
+      : stor(stor),
+        queries(queries),
+        local(localStation(stor)),
+        select_changes(queries.Connection(),
+                       "SELECT relogio, operacao, origem, doacao, data,"
+                       " tamanho, condicao, status, descricao, nome, telefone"
+                       " FROM alteracao WHERE estacao = ? AND relogio > ?"
+                       " ORDER BY relogio"),
+        set_exported(queries.Connection(),
+                     "UPDATE estacao SET exportado = ? WHERE local = 1"),
+        find_station(queries.Connection(),
+                     "SELECT relogio FROM estacao WHERE id = ?"),
+        insert_station(queries.Connection(),
+                       "INSERT INTO estacao (id, local, relogio, exportado)"
+                       " VALUES (?, 0, 0, 0)"),
+        set_clock(queries.Connection(),
+                  "UPDATE estacao SET relogio = ? WHERE id = ?"),
+        find_donation(queries.Connection(),
+                      "SELECT 1 FROM doacao WHERE id = ?"),
+        find_replica(queries.Connection(),
+                     "SELECT doacao FROM replica"
+                     " WHERE origem = ? AND doacao_origem = ?"),
+        insert_replica(queries.Connection(),
+                       "INSERT INTO replica (origem, doacao_origem, doacao)"
+                       " VALUES (?, ?, ?)"),
+        append_change(queries.Connection(),
+                      "INSERT INTO alteracao (estacao, relogio, operacao,"
+                      " origem, doacao, data, tamanho, condicao, status,"
+                      " descricao, nome, telefone)"
+                      " VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)") {}
+
+  long long Station() const { return local.id; }
+
+  // Grava as alterações locais ainda não exportadas, ou todas, e devolve
+  // quantas foram gravadas
+  size_t Export(const std::string& arquivo, bool desde_inicio = false) {
+    const int desde = desde_inicio ? 0 : local.exportado;
+
+    select_changes.Bind(1, local.id).Bind(2, desde);
+
+    std::vector<Alteracao> alteracoes;
+    while (select_changes.Step()) {
+      alteracoes.push_back(Alteracao{
+          0,
+          local.id,
+          select_changes.ColumnInt(0),
+          static_cast<Operacao>(select_changes.ColumnInt(1)),
+          select_changes.ColumnInt64(2),
+          select_changes.ColumnInt(3),
+          select_changes.ColumnInt(4),
+          static_cast<Tamanho>(select_changes.ColumnInt(5)),
+          static_cast<Condicao>(select_changes.ColumnInt(6)),
+          static_cast<Status>(select_changes.ColumnInt(7)),
+          select_changes.ColumnText(8),
+          select_changes.ColumnText(9),
+          select_changes.ColumnText(10),
+      });
+    }
+    select_changes.Reset();
+
+    Encoder encoder;
+    encoder.bytes.append(kMagic, sizeof(kMagic));
+    encoder.Signed(local.id);
+    encoder.Unsigned(desde);
+    encoder.Unsigned(alteracoes.size());
+
+    int anterior = desde;
+    for (const Alteracao& alteracao : alteracoes) {
+      encoder.Unsigned(static_cast<uint8_t>(alteracao.operacao));
+      encoder.Unsigned(alteracao.relogio - anterior);
+      encoder.Signed(alteracao.origem - local.id);
+      encoder.Unsigned(alteracao.doacao);
+
+      if (alteracao.operacao == Operacao::kInserir) {
+        encoder.Unsigned(alteracao.data);
+        encoder.Unsigned(static_cast<uint8_t>(alteracao.tamanho));
+        encoder.Unsigned(static_cast<uint8_t>(alteracao.condicao));
+        encoder.Unsigned(static_cast<uint8_t>(alteracao.status));
+        encoder.Text(alteracao.descricao);
+        encoder.Text(alteracao.nome);
+        encoder.Text(alteracao.telefone);
+      } else if (alteracao.operacao == Operacao::kStatus) {
+        encoder.Unsigned(static_cast<uint8_t>(alteracao.status));
+      }
+
+      anterior = alteracao.relogio;
+    }
+
+    std::ofstream out(arquivo, std::ios::binary | std::ios::trunc);
+    out.write(encoder.bytes.data(),
+              static_cast<std::streamsize>(encoder.bytes.size()));
+    out.close();
+    if (!out) throw std::runtime_error("Não foi possível gravar " + arquivo);
+
+    if (!alteracoes.empty() && anterior > local.exportado) {
+      set_exported.Bind(1, anterior);
+      set_exported.Step();
+      set_exported.Reset();
+      local.exportado = anterior;
+    }
+
+    return alteracoes.size();
+  }
+
+  SyncResult Import(const std::vector<std::string>& arquivos) {
+    SyncResult result;
+    std::vector<Delta> deltas;
+
+    for (const std::string& arquivo : arquivos) {
+      Delta delta;
+      if (Read(arquivo, delta, result)) {
+        result.arquivos++;
+        result.alteracoes += delta.alteracoes.size();
+        deltas.push_back(std::move(delta));
+      }
+    }
+
+    // Arquivos de uma mesma estação podem chegar em qualquer ordem
+    std::sort(deltas.begin(), deltas.end(),
+              [](const Delta& a, const Delta& b) {
+                return std::make_pair(a.estacao, a.Primeiro()) <
+                       std::make_pair(b.estacao, b.Primeiro());
+              });
+
+    stor.transaction([&] {
+      std::vector<Fila> filas;
+
+      for (size_t i = 0; i < deltas.size();) {
+        // Todos os arquivos da mesma estação, em ordem de relógio
+        size_t fim = i;
+        while (fim < deltas.size() && deltas[fim].estacao == deltas[i].estacao)
+          fim++;
+
+        Open(deltas.begin() + i, deltas.begin() + fim, filas, result);
+        i = fim;
+      }
+
+      // Cada rodada pode aplicar os cadastros que destravam outra estação
+      bool avancou = true;
+      while (avancou) {
+        avancou = false;
+        for (Fila& fila : filas) avancou |= Advance(fila, result);
+      }
+
+      for (Fila& fila : filas) {
+        if (!fila.interrompida && fila.proxima < fila.alteracoes.size()) {
+          const Alteracao& parada = *fila.alteracoes[fila.proxima];
+          result.pendentes += fila.alteracoes.size() - fila.proxima;
+          result.erros.push_back(
+              "Alterações da estação " + std::to_string(fila.estacao) +
+              " a partir de " + std::to_string(parada.relogio) +
+              " aguardam a doação " + std::to_string(parada.doacao) +
+              " da estação " + std::to_string(parada.origem));
+        }
+
+        Finish(fila.estacao, fila.relogio);
+      }
+
+      return true;
+    });
+
+    return result;
+  }
+
+ private:
+  static constexpr char kMagic[4] = {'A', 'G', 'S', '1'};
+
+  struct Delta {
+    long long estacao = 0;
+    std::vector<Alteracao> alteracoes;
+
+    int Primeiro() const {
+      return alteracoes.empty() ? 0 : alteracoes.front().relogio;
+    }
+  };
+
+  // Alterações de uma estação ainda não aplicadas nesta importação
+  struct Fila {
+    long long estacao = 0;
+    int relogio = 0;  // da última alteração aplicada
+    std::vector<const Alteracao*> alteracoes;
+    size_t proxima = 0;
+    bool interrompida = false;  // por uma lacuna no relógio
+  };
+
+  struct Encoder {
+    std::string bytes;
+
+    void Unsigned(uint64_t valor) {
+      while (valor >= 0x80) {
+        bytes.push_back(static_cast<char>(valor | 0x80));
+        valor >>= 7;
+      }
+      bytes.push_back(static_cast<char>(valor));
+    }
+
+    // Zigzag, para que valores negativos pequenos também ocupem pouco
+    void Signed(long long valor) {
+      Unsigned((static_cast<uint64_t>(valor) << 1) ^
+               static_cast<uint64_t>(valor >> 63));
+    }
+
+    void Text(const std::string& texto) {
+      Unsigned(texto.size());
+      bytes += texto;
+    }
+  };
+
+  // Leitura com verificação de limites. Depois de um erro, ok fica false e
+  // os valores lidos são zero
+  struct Decoder {
+    const std::string& bytes;
+    size_t posicao = 0;
+    bool ok = true;
+
+    uint64_t Unsigned() {
+      uint64_t valor = 0;
+      for (int deslocamento = 0; deslocamento < 64; deslocamento += 7) {
+        if (posicao >= bytes.size()) break;
+
+        const auto byte = static_cast<uint8_t>(bytes[posicao++]);
+        valor |= static_cast<uint64_t>(byte & 0x7F) << deslocamento;
+        if (byte < 0x80) return valor;
+      }
+
+      ok = false;
+      return 0;
+    }
+
+    long long Signed() {
+      const uint64_t valor = Unsigned();
+      return static_cast<long long>(valor >> 1) ^
+             -static_cast<long long>(valor & 1);
+    }
+
+    std::string Text() {
+      const uint64_t tamanho = Unsigned();
+      if (tamanho > bytes.size() - posicao) {
+        ok = false;
+        return std::string();
+      }
+
+      std::string texto = bytes.substr(posicao, tamanho);
+      posicao += tamanho;
+      return texto;
+    }
+
+    // Código de um enum com N valores
+    template <typename Code>
+    Code Enum(int n) {
+      const uint64_t valor = Unsigned();
+      if (valor >= static_cast<uint64_t>(n)) ok = false;
+
+      return static_cast<Code>(ok ? valor : 0);
+    }
+  };
+
+  bool Read(const std::string& arquivo, Delta& delta, SyncResult& result) {
+    std::ifstream in(arquivo, std::ios::binary);
+    const std::string bytes((std::istreambuf_iterator<char>(in)),
+                            std::istreambuf_iterator<char>());
+
+    if (!in.good() && !in.eof()) {
+      result.erros.push_back("Não foi possível ler " + arquivo);
+      return false;
+    }
+
+    if (bytes.compare(0, sizeof(kMagic), kMagic, sizeof(kMagic)) != 0) {
+      result.erros.push_back(arquivo + " não é um arquivo de alterações");
+      return false;
+    }
+
+    Decoder decoder{bytes, sizeof(kMagic)};
+    delta.estacao = decoder.Signed();
+    int relogio = static_cast<int>(decoder.Unsigned());
+    const uint64_t quantidade = decoder.Unsigned();
+
+    for (uint64_t n = 0; n < quantidade && decoder.ok; n++) {
+      Alteracao alteracao{};
+      alteracao.estacao = delta.estacao;
+      alteracao.operacao = decoder.Enum<Operacao>(3);
+      relogio += static_cast<int>(decoder.Unsigned());
+      alteracao.relogio = relogio;
+      alteracao.origem = delta.estacao + decoder.Signed();
+      alteracao.doacao = static_cast<int>(decoder.Unsigned());
+
+      if (alteracao.operacao == Operacao::kInserir) {
+        alteracao.data = static_cast<int>(decoder.Unsigned());
+        alteracao.tamanho = decoder.Enum<Tamanho>(kTamanhoCount);
+        alteracao.condicao = decoder.Enum<Condicao>(kCondicaoCount);
+        alteracao.status = decoder.Enum<Status>(kStatusCount);
+        alteracao.descricao = decoder.Text();
+        alteracao.nome = decoder.Text();
+        alteracao.telefone = decoder.Text();
+      } else if (alteracao.operacao == Operacao::kStatus) {
+        alteracao.status = decoder.Enum<Status>(kStatusCount);
+      }
+
+      delta.alteracoes.push_back(std::move(alteracao));
+    }
+
+    if (!decoder.ok || decoder.posicao != bytes.size()) {
+      result.erros.push_back(arquivo + " está incompleto ou corrompido");
+      return false;
+    }
+
+    return true;
+  }
+
+  template <typename Iterator>
+  void Open(Iterator inicio, Iterator fim, std::vector<Fila>& filas,
+            SyncResult& result) {
+    const long long estacao = inicio->estacao;
+
+    // As próprias alterações, de volta de outra estação
+    if (estacao == local.id) {
+      for (Iterator delta = inicio; delta != fim; ++delta)
+        result.repetidas += delta->alteracoes.size();
+      return;
+    }
+
+    Fila fila;
+    fila.estacao = estacao;
+
+    find_station.Bind(1, estacao);
+    if (find_station.Step()) {
+      fila.relogio = find_station.ColumnInt(0);
+    } else {
+      insert_station.Bind(1, estacao);
+      Run(insert_station);
+    }
+    find_station.Reset();
+
+    for (Iterator delta = inicio; delta != fim; ++delta) {
+      for (const Alteracao& alteracao : delta->alteracoes)
+        fila.alteracoes.push_back(&alteracao);
+    }
+
+    filas.push_back(std::move(fila));
+  }
+
+  // Aplica as alterações da estação até a primeira que depende de uma
+  // doação ainda não cadastrada, e indica se alguma foi aplicada
+  bool Advance(Fila& fila, SyncResult& result) {
+    bool avancou = false;
+
+    for (; fila.proxima < fila.alteracoes.size(); fila.proxima++) {
+      const Alteracao& alteracao = *fila.alteracoes[fila.proxima];
+
+      if (alteracao.relogio <= fila.relogio) {
+        result.repetidas++;
+        continue;
+      }
+
+      if (fila.interrompida) break;
+
+      if (alteracao.relogio != fila.relogio + 1) {
+        result.erros.push_back(
+            "Faltam alterações da estação " + std::to_string(fila.estacao) +
+            " entre " + std::to_string(fila.relogio + 1) + " e " +
+            std::to_string(alteracao.relogio - 1));
+        fila.interrompida = true;
+        break;
+      }
+
+      if (!Apply(alteracao, result)) break;
+
+      fila.relogio = alteracao.relogio;
+      avancou = true;
+    }
+
+    return avancou;
+  }
+
+  void Finish(long long estacao, int relogio) {
+    set_clock.Bind(1, relogio).Bind(2, estacao);
+    Run(set_clock);
+  }
+
+  // Devolve false, sem aplicar nem registrar, se a alteração é de uma doação
+  // que ainda não chegou aqui
+  bool Apply(const Alteracao& alteracao, SyncResult& result) {
+    const int id = LocalId(alteracao.origem, alteracao.doacao);
+    if (id == 0 && alteracao.operacao != Operacao::kInserir) return false;
+
+    // A doação chegou, mas foi removida depois
+    const bool removida = id != 0 && !Exists(id);
+
+    switch (alteracao.operacao) {
+      case Operacao::kInserir:
+        if (id == 0) {
+          const Doador doador{-1, alteracao.nome, alteracao.telefone};
+          const auto existente = queries.FindDonorByPhone(doador.telefone);
+
+          const int novo = queries.InsertDonation(Doacao{
+              -1, alteracao.data, alteracao.tamanho, alteracao.condicao,
+              alteracao.status, alteracao.descricao,
+              existente ? *existente : queries.InsertDonor(doador)});
+
+          insert_replica.Bind(1, alteracao.origem)
+              .Bind(2, alteracao.doacao)
+              .Bind(3, novo);
+          Run(insert_replica);
+        }
+        break;
+
+      case Operacao::kStatus:
+        if (!removida) queries.UpdateStatus(id, alteracao.status);
+        break;
+
+      case Operacao::kRemover:
+        if (!removida) queries.RemoveDonation(id);
+        break;
+    }
+
+    if (removida && alteracao.operacao != Operacao::kInserir) {
+      result.ignoradas++;
+    } else {
+      result.aplicadas++;
+    }
+
+    // Guarda a alteração como veio, com a estação e o relógio de origem
+    append_change.Bind(1, alteracao.estacao)
+        .Bind(2, alteracao.relogio)
+        .Bind(3, static_cast<int>(alteracao.operacao))
+        .Bind(4, alteracao.origem)
+        .Bind(5, alteracao.doacao)
+        .Bind(6, alteracao.data)
+        .Bind(7, static_cast<int>(alteracao.tamanho))
+        .Bind(8, static_cast<int>(alteracao.condicao))
+        .Bind(9, static_cast<int>(alteracao.status))
+        .Bind(10, alteracao.descricao)
+        .Bind(11, alteracao.nome)
+        .Bind(12, alteracao.telefone);
+    Run(append_change);
+    return true;
+  }
+
+  // Id local da doação cadastrada em origem com o id doacao, ou 0 se ela
+  // ainda não chegou aqui
+  int LocalId(long long origem, int doacao) {
+    if (origem == local.id) return doacao;
+
+    find_replica.Bind(1, origem).Bind(2, doacao);
+    const int id = find_replica.Step() ? find_replica.ColumnInt(0) : 0;
+    find_replica.Reset();
+
+    return id;
+  }
+
+  bool Exists(int id) {
+    find_donation.Bind(1, id);
+    const bool existe = find_donation.Step();
+    find_donation.Reset();
+
+    return existe;
+  }
+
+  static void Run(Statement& statement) {
+    statement.Step();
+    statement.Reset();
+  }
+
+  Storage& stor;
+  Queries& queries;
+  Estacao local;
+
+  Statement select_changes;
+  Statement set_exported;
+  Statement find_station;
+  Statement insert_station;
+  Statement set_clock;
+  Statement find_donation;
+  Statement find_replica;
+  Statement insert_replica;
+  Statement append_change;
+};
@@ -0,0 +1,514 @@
+#pragma once
+
+#include <sqlite3.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "queries.hpp"
+#include "storage.hpp"
+
+enum class ReportFormat { kCsv, kJson };
+
+struct ReportOptions {
+  // Período em AAAAMMDD, como no filtro do estoque. 0 deixa o intervalo
+  // aberto daquele lado
+  int inicio = 0;
+  int fim = 0;
+
+  int maiores_doadores = 20;
+  ReportFormat formato = ReportFormat::kCsv;
+};
+
+struct ReportResult {
+  size_t doacoes = 0;  // doações do período
+  size_t meses = 0;
+  size_t sem_data = 0;  // do período, fora dos meses por terem data inválida
+  size_t doadores = 0;
+
+  // Arquivos gravados, e os erros que impediram o relatório de terminar
+  std::vector<std::string> arquivos;
+  std::vector<std::string> erros;
+};
+
+// Progresso de um relatório, escrito pelo thread que o gera e lido pela
+// interface. notify, se definido antes de começar, é chamado a cada avanço
+struct ReportProgress {
+  std::atomic<size_t> lidas{0};
+  std::atomic<size_t> total{0};
+  std::atomic<bool> cancelar{false};
+  std::function<void()> notify;
+};
+
+// Escreve as linhas de uma tabela do relatório conforme elas são lidas, sem
+// guardá-las: em CSV, com ponto e vírgula como as planilhas em português, ou
+// como um vetor de objetos dentro do JSON
+class ReportWriter {
+ public:
+  ReportWriter(std::ostream& out, ReportFormat formato)
+      : out(out), formato(formato) {}
+
+  void BeginTable(const char* nome, std::initializer_list<const char*> nomes) {
+    colunas.assign(nomes.begin(), nomes.end());
+    linhas = 0;
+
+    if (formato == ReportFormat::kCsv) {
+      for (size_t i = 0; i < colunas.size(); i++)
+        out << (i ? ";" : "") << colunas[i];
+      out << "\n";
+    } else {
+      out << ",\n  \"" << nome << "\": [";
+    }
+  }
+
+  void Field(std::string_view texto) {
+    BeginField();
+
+    if (formato == ReportFormat::kCsv) {
+      WriteCsv(texto);
+    } else {
+      WriteJson(texto);
+    }
+  }
+
+  void Field(long long numero) {
+    BeginField();
+    out << numero;
+  }
+
+  void EndRow() {
+    out << (formato == ReportFormat::kCsv ? "\n" : "}");
+    coluna = 0;
+    linhas++;
+  }
+
+  void EndTable() {
+    if (formato == ReportFormat::kJson) out << (linhas ? "\n  ]" : "]");
+  }
+
+ private:
+  void BeginField() {
+    if (formato == ReportFormat::kCsv) {
+      if (coluna) out << ";";
+    } else {
+      if (coluna == 0) out << (linhas ? ",\n    {" : "\n    {");
+      out << (coluna ? ", \"" : "\"") << colunas[coluna] << "\": ";
+    }
+
+    coluna++;
+  }
+
+  // Campos com o separador, aspas ou quebras de linha vão entre aspas
+  void WriteCsv(std::string_view texto) {
+    if (texto.find_first_of(";\"\r\n") == std::string_view::npos) {
+      out << texto;
+      return;
+    }
+
+    out << '"';
+    for (char c : texto) {
+      if (c == '"') out << '"';
+      out << c;
+    }
+    out << '"';
+  }
+
+  void WriteJson(std::string_view texto) {
+    out << '"';
+    for (char c : texto) {
+      if (c == '"' || c == '\\') {
+        out << '\\' << c;
+      } else if (static_cast<unsigned char>(c) < 0x20) {
+        char escape[8];
+        snprintf(escape, sizeof(escape), "\\u%04x", static_cast<int>(c));
+        out << escape;
+      } else {
+        out << c;
+      }
+    }
+    out << '"';
+  }
+
+  std::ostream& out;
+  ReportFormat formato;
+  std::vector<const char*> colunas;
+  size_t coluna = 0;
+  size_t linhas = 0;
+};
+
+// Relatório mensal para a coordenação: doações recebidas e entregues por mês,
+// tamanho e condição, e os doadores com mais doações no período.
+//
+// Usa uma conexão própria, aberta só para leitura, e lê tudo dentro de uma
+// única transação, então o relatório inteiro vê o mesmo estado do banco
+// enquanto o aplicativo continua gravando (no modo WAL, sem bloqueá-lo). O
+// banco não guarda a data da entrega, então as entregues são as doações
+// recebidas no mês que já estão com o status "Doado".
+//
+// Em CSV são gravados dois arquivos, destino-mensal.csv e
+// destino-doadores.csv; em JSON, um único destino.json com as duas tabelas.
+// Eles são escritos com a extensão .parcial e só recebem o nome final quando
+// o relatório termina, então um relatório cancelado ou interrompido por um
+// erro não deixa arquivos incompletos com o nome de um relatório pronto
+class ReportGenerator {
+ public:
+  explicit ReportGenerator(const std::string& path) {
+    if (sqlite3_open_v2(path.c_str(), &db, SQLITE_OPEN_READONLY, nullptr) !=
+        SQLITE_OK) {
+      std::string message = sqlite3_errmsg(db);
+      sqlite3_close(db);
+
+      throw std::runtime_error("Erro ao abrir o banco: " + message);
+    }
+
+    sqlite3_busy_timeout(db, StorageProfile().busy_timeout_ms);
+  }
+
+  ~ReportGenerator() { sqlite3_close(db); }
+
+  ReportGenerator(const ReportGenerator&) = delete;
+  ReportGenerator& operator=(const ReportGenerator&) = delete;
+
+  // O destino pode vir com ou sem a extensão
+  ReportResult Generate(std::string destino, const ReportOptions& options,
+                        ReportProgress* progresso = nullptr) {
+    ReportResult result;
+    ReportProgress local;
+    if (!progresso) progresso = &local;
+
+    for (const char* extensao : {".csv", ".json"}) {
+      const size_t tamanho = strlen(extensao);
+      if (destino.size() > tamanho &&
+          destino.compare(destino.size() - tamanho, tamanho, extensao) == 0)
+        destino.resize(destino.size() - tamanho);
+    }
+
+    const bool csv = options.formato == ReportFormat::kCsv;
+    const std::string mensal = destino + (csv ? "-mensal.csv" : ".json");
+    const std::string doadores = destino + "-doadores.csv";
+
+    const std::string parcial_mensal = mensal + kPartial;
+    const std::string parcial_doadores = doadores + kPartial;
+
+    std::ofstream out_mensal(parcial_mensal, std::ios::binary);
+    std::ofstream out_doadores;
+    if (csv) out_doadores.open(parcial_doadores, std::ios::binary);
+
+    // Apaga os arquivos parciais de um relatório que não terminou
+    auto descartar = [&] {
+      out_mensal.close();
+      out_doadores.close();
+
+      std::error_code erro;
+      std::filesystem::remove(parcial_mensal, erro);
+      if (csv) std::filesystem::remove(parcial_doadores, erro);
+    };
+
+    if (!out_mensal || (csv && !out_doadores)) {
+      result.erros.push_back("Não foi possível criar " +
+                             (out_mensal ? doadores : mensal));
+      descartar();
+      return result;
+    }
+
+    try {
+      Exec("BEGIN;");
+
+      if (csv) {
+        // A marca de ordem de bytes faz as planilhas lerem o UTF-8
+        out_mensal << "\xEF\xBB\xBF";
+        out_doadores << "\xEF\xBB\xBF";
+
+        ReportWriter escrita_mensal(out_mensal, options.formato);
+        ReportWriter escrita_doadores(out_doadores, options.formato);
+        WriteMonths(escrita_mensal, options, *progresso, result);
+        WriteDonors(escrita_doadores, options, result);
+      } else {
+        ReportWriter escrita(out_mensal, options.formato);
+
+        out_mensal << "{\n  \"inicio\": " << options.inicio
+                   << ",\n  \"fim\": " << options.fim;
+        WriteMonths(escrita, options, *progresso, result);
+        WriteDonors(escrita, options, result);
+        out_mensal << ",\n  \"sem_data\": " << result.sem_data << "\n}\n";
+      }
+
+      Exec("COMMIT;");
+    } catch (...) {
+      sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+      descartar();
+      throw;
+    }
+
+    if (progresso->cancelar) {
+      result.erros.push_back("Relatório cancelado");
+      descartar();
+      return result;
+    }
+
+    out_mensal.close();
+    if (csv) out_doadores.close();
+
+    if (!out_mensal || (csv && !out_doadores)) {
+      result.erros.push_back("Erro ao gravar o relatório");
+      descartar();
+      return result;
+    }
+
+    // Substitui um relatório anterior com o mesmo nome
+    std::error_code erro;
+    std::filesystem::rename(parcial_mensal, mensal, erro);
+    if (!erro && csv)
+      std::filesystem::rename(parcial_doadores, doadores, erro);
+
+    if (erro) {
+      result.erros.push_back("Não foi possível renomear o relatório: " +
+                             erro.message());
+      descartar();
+      return result;
+    }
+
+    result.arquivos.push_back(mensal);
+    if (csv) result.arquivos.push_back(doadores);
+
+    return result;
+  }
+
+ private:
+  // Extensão dos arquivos enquanto o relatório é gerado
+  static constexpr const char* kPartial = ".parcial";
+
+  // A cada quantas doações lidas o progresso é atualizado
+  static constexpr size_t kProgressStep = 4096;
+
+  // Filtro do período, como nas consultas do estoque
+  static std::string Where(const ReportOptions& options) {
+    std::string onde = " WHERE 1";
+    if (options.inicio) onde += " AND doacao.data >= :inicio";
+    if (options.fim) onde += " AND doacao.data <= :fim";
+
+    return onde;
+  }
+
+  static void Bind(Statement& statement, const ReportOptions& options) {
+    if (int i = statement.Parameter(":inicio"))
+      statement.Bind(i, options.inicio);
+    if (int i = statement.Parameter(":fim")) statement.Bind(i, options.fim);
+  }
+
+  // Percorre as doações pela ordem do índice da data, somando as do mês
+  // atual, e escreve cada mês assim que ele termina. As de data inválida não
+  // pertencem a nenhum mês, e são só contadas
+  void WriteMonths(ReportWriter& escrita, const ReportOptions& options,
+                   ReportProgress& progresso, ReportResult& result) {
+    const std::string validas = "doacao.data BETWEEN " +
+                                std::to_string(kMinDate) + " AND " +
+                                std::to_string(kMaxDate);
+
+    Statement invalidas(db, ("SELECT COUNT(*) FROM doacao" + Where(options) +
+                             " AND NOT (" + validas + ")")
+                                .c_str());
+    Bind(invalidas, options);
+    result.sem_data = invalidas.Step() ? invalidas.ColumnInt(0) : 0;
+    invalidas.Reset();
+
+    Statement contar(db, ("SELECT COUNT(*) FROM doacao" + Where(options) +
+                          " AND " + validas)
+                             .c_str());
+    Bind(contar, options);
+    progresso.total = contar.Step() ? contar.ColumnInt(0) : 0;
+    contar.Reset();
+
+    Statement select(db, ("SELECT data, tamanho, condicao, status FROM doacao" +
+                          Where(options) + " AND " + validas +
+                          " ORDER BY data")
+                             .c_str());
+    Bind(select, options);
+
+    escrita.BeginTable("mensal", {"mes", "tamanho", "condicao", "recebidas",
+                                  "entregues", "disponiveis"});
+
+    int recebidas[kTamanhoCount][kCondicaoCount] = {};
+    int entregues[kTamanhoCount][kCondicaoCount] = {};
+    int mes = 0;
+
+    auto escrever_mes = [&] {
+      char texto[16];
+      snprintf(texto, sizeof(texto), "%02d/%04d", mes % 100, mes / 100);
+
+      for (int t = 0; t < kTamanhoCount; t++) {
+        for (int c = 0; c < kCondicaoCount; c++) {
+          if (recebidas[t][c] == 0) continue;
+
+          escrita.Field(texto);
+          escrita.Field(kTamanhos[t]);
+          escrita.Field(kCondicoes[c]);
+          escrita.Field(recebidas[t][c]);
+          escrita.Field(entregues[t][c]);
+          escrita.Field(recebidas[t][c] - entregues[t][c]);
+          escrita.EndRow();
+
+          recebidas[t][c] = 0;
+          entregues[t][c] = 0;
+        }
+      }
+
+      result.meses++;
+    };
+
+    while (!progresso.cancelar && select.Step()) {
+      const int data = select.ColumnInt(0);
+      if (data / 100 != mes) {
+        if (mes) escrever_mes();
+        mes = data / 100;
+      }
+
+      const int tamanho = select.ColumnInt(1);
+      const int condicao = select.ColumnInt(2);
+      if (tamanho < 0 || tamanho >= kTamanhoCount || condicao < 0 ||
+          condicao >= kCondicaoCount)
+        continue;
+
+      recebidas[tamanho][condicao]++;
+      if (select.ColumnInt(3) == static_cast<int>(Status::kDoado))
+        entregues[tamanho][condicao]++;
+
+      if (++result.doacoes % kProgressStep == 0) {
+        progresso.lidas = result.doacoes;
+        if (progresso.notify) progresso.notify();
+      }
+    }
+    select.Reset();
+
+    if (mes) escrever_mes();
+    escrita.EndTable();
+
+    progresso.lidas = result.doacoes;
+  }
+
+  void WriteDonors(ReportWriter& escrita, const ReportOptions& options,
+                   ReportResult& result) {
+    Statement select(
+        db, ("SELECT doador.nome, doador.telefone, COUNT(*) AS total,"
+             " SUM(doacao.status = " +
+             std::to_string(static_cast<int>(Status::kDoado)) +
+             ") FROM doacao JOIN doador ON doador.id = doacao.id_doador" +
+             Where(options) +
+             " GROUP BY doador.id ORDER BY total DESC, doador.id"
+             " LIMIT :limite")
+                .c_str());
+    Bind(select, options);
+    select.Bind(select.Parameter(":limite"), options.maiores_doadores);
+
+    escrita.BeginTable("doadores", {"posicao", "nome", "telefone", "doacoes",
+                                    "entregues"});
+
+    while (select.Step()) {
+      escrita.Field(static_cast<long long>(++result.doadores));
+      escrita.Field(select.ColumnView(0));
+      escrita.Field(select.ColumnView(1));
+      escrita.Field(select.ColumnInt(2));
+      escrita.Field(select.ColumnInt(3));
+      escrita.EndRow();
+    }
+    select.Reset();
+
+    escrita.EndTable();
+  }
+
+  void Exec(const char* sql) {
+    char* error = nullptr;
+    if (sqlite3_exec(db, sql, nullptr, nullptr, &error) != SQLITE_OK) {
+      std::string message = error ? error : "erro desconhecido";
+      sqlite3_free(error);
+
+      throw std::runtime_error("Erro ao ler o banco: " + message);
+    }
+  }
+
+  sqlite3* db = nullptr;
+};
+
+// Relatório gerado em um thread próprio, para que nem a interface nem as
+// escritas do thread do banco esperem por ele. A interface acompanha o
+// progresso e recolhe o resultado com Finish() quando Done() indicar o fim
+class ReportJob {
+ public:
+  ~ReportJob() {
+    progresso.cancelar = true;
+    if (thread.joinable()) thread.join();
+  }
+
+  // notify é chamado (no thread do relatório) a cada avanço e no final
+  void Start(std::string banco, std::string destino, ReportOptions options,
+             std::function<void()> notify) {
+    if (thread.joinable()) thread.join();
+
+    progresso.lidas = 0;
+    progresso.total = 0;
+    progresso.cancelar = false;
+    progresso.notify = notify;
+    terminado = false;
+    result.reset();
+
+    thread = std::thread([this, banco = std::move(banco),
+                          destino = std::move(destino), options,
+                          notify = std::move(notify)] {
+      ReportResult gerado;
+
+      try {
+        gerado = ReportGenerator(banco).Generate(destino, options, &progresso);
+      } catch (const std::exception& e) {
+        gerado.erros.push_back(e.what());
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        result = std::move(gerado);
+      }
+
+      terminado = true;
+      if (notify) notify();
+    });
+  }
+
+  bool Running() const { return thread.joinable(); }
+  bool Done() const { return terminado; }
+
+  // Fração das doações já lidas, entre 0 e 1
+  float Fraction() const {
+    const size_t total = progresso.total;
+    return total ? static_cast<float>(progresso.lidas) / total : 0.0f;
+  }
+
+  // Espera o thread, que já terminou, e devolve o resultado
+  ReportResult Finish() {
+    thread.join();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    return std::move(*result);
+  }
+
+  void Cancel() { progresso.cancelar = true; }
+
+ private:
+  ReportProgress progresso;
+  std::atomic<bool> terminado{false};
+  std::mutex mutex;
+  std::optional<ReportResult> result;
+  std::thread thread;
+};
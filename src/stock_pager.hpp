@@ -0,0 +1,470 @@
+#pragma once
+
+#include <sqlite3.h>
+
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "queries.hpp"
+#include "string_pool.hpp"
+
+// Linha da aba de estoque: a doação junto com o nome do doador
+struct StockRow {
+  int id;
+  int data;
+  Tamanho tamanho;
+  Condicao condicao;
+  Status status;
+
+  // Os textos apontam para o StringPool da página da linha
+  std::string_view descricao;
+  int id_doador;
+  std::string_view doador;
+
+  // Removida pelo usuário, aguardando a gravação e o recarregamento
+  bool removida = false;
+};
+
+struct StockFilter {
+  bool apenas_disponiveis = true;
+
+  // Período em AAAAMMDD. 0 significa que o intervalo é aberto daquele lado
+  int inicio = 0;
+  int fim = 0;
+
+  // Texto procurado na descrição, vazio para não filtrar
+  std::string busca;
+
+  bool operator==(const StockFilter& outro) const {
+    return apenas_disponiveis == outro.apenas_disponiveis &&
+           inicio == outro.inicio && fim == outro.fim && busca == outro.busca;
+  }
+
+  bool operator!=(const StockFilter& outro) const { return !(*this == outro); }
+};
+
+// Colunas pelas quais o estoque pode ser ordenado
+enum class StockSort { kData, kTamanho, kCondicao, kDoador, kStatus };
+
+// Estoque lido do banco por páginas, com a ordenação e os filtros aplicados
+// no próprio SQL. Só as páginas próximas da área visível ficam na memória,
+// então o custo acompanha o tamanho da tela e não o da tabela.
+//
+// As páginas são buscadas por keyset: a página seguinte começa logo depois da
+// chave de ordenação da última linha da anterior, o que usa o índice da
+// coluna em vez de percorrer as linhas puladas. A chave que antecede cada
+// página já vista é guardada, e só um salto para uma região nunca carregada
+// usa OFFSET.
+//
+// As doações que não estão no banco não aparecem, então depois de cada
+// escrita o estoque precisa ser invalidado. As páginas usam a conexão do
+// thread da interface; a contagem, que percorre todas as linhas filtradas, é
+// feita por Count() no thread do banco e entregue a Refresh().
+class StockPager {
+ public:
+  static constexpr int kPageSize = 128;
+  static constexpr size_t kMaxPages = 16;
+
+  explicit StockPager(sqlite3* db) : db(db) {}
+
+  // Troca a ordenação ou os filtros, e indica se algum deles mudou. As
+  // consultas só são preparadas de novo quando muda a forma delas (a
+  // ordenação ou quais filtros estão ativos); o texto da busca e as datas são
+  // apenas parâmetros
+  bool Configure(StockSort ordem, bool crescente, const StockFilter& filtro) {
+    if (preparado && ordem == this->ordem && crescente == this->crescente &&
+        filtro == this->filtro)
+      return false;
+
+    const bool mesma_forma = preparado && ordem == this->ordem &&
+                             crescente == this->crescente &&
+                             Shape(filtro) == Shape(this->filtro);
+
+    this->ordem = ordem;
+    this->crescente = crescente;
+    this->filtro = filtro;
+
+    if (!mesma_forma) Prepare();
+    Invalidate();
+    return true;
+  }
+
+  const StockFilter& Filter() const { return filtro; }
+
+  // Descarta as páginas carregadas, que são relidas conforme a rolagem, e
+  // marca a contagem como desatualizada. Chamado depois de uma escrita no
+  // banco ou de uma troca de filtros
+  void Invalidate() {
+    paginas.clear();
+    chaves.clear();
+
+    sujo = true;
+    geracao++;
+  }
+
+  // Indica se a contagem precisa ser refeita
+  bool Dirty() const { return sujo; }
+
+  // Muda a cada Invalidate(), para que uma contagem pedida antes dele seja
+  // descartada
+  unsigned Generation() const { return geracao; }
+
+  // Linhas que passam pelo filtro. Executado no thread do banco, com a
+  // conexão dele
+  static int Count(sqlite3* db, const StockFilter& filtro) {
+    const std::string sql = std::string("SELECT COUNT(*) ") +
+                            From(StockSort::kData) + Where(filtro);
+
+    Statement contar(db, sql.c_str());
+    BindFilter(contar, filtro);
+
+    return contar.Step() ? contar.ColumnInt(0) : 0;
+  }
+
+  // Recebe a contagem feita por Count() para a geração indicada. Uma
+  // contagem de uma geração anterior é ignorada, e indica-se se foi aceita
+  bool Refresh(unsigned geracao, int total) {
+    if (geracao != this->geracao) return false;
+
+    this->total = total;
+    sujo = false;
+    return true;
+  }
+
+  // Quantidade de linhas que passam pelos filtros
+  int Size() const { return total; }
+
+  // Indica se as linhas [inicio, fim) já estão carregadas
+  bool Loaded(int inicio, int fim) const {
+    if (inicio >= fim) return true;
+
+    for (int pagina = inicio / kPageSize; pagina <= (fim - 1) / kPageSize;
+         pagina++) {
+      if (paginas.count(pagina) == 0) return false;
+    }
+
+    return true;
+  }
+
+  // Carrega as páginas das linhas [inicio, fim) que faltam, e devolve
+  // quantas linhas foram lidas
+  size_t Load(int inicio, int fim) {
+    size_t lidas = 0;
+    if (inicio >= fim) return lidas;
+
+    const int primeira = inicio / kPageSize;
+    const int ultima = (fim - 1) / kPageSize;
+
+    for (int pagina = primeira; pagina <= ultima; pagina++) {
+      if (paginas.count(pagina) == 0) lidas += LoadPage(pagina);
+    }
+
+    // Descarta as páginas mais distantes da área pedida
+    while (paginas.size() > kMaxPages) {
+      auto inicio_mapa = paginas.begin();
+      auto fim_mapa = std::prev(paginas.end());
+
+      if (primeira - inicio_mapa->first > fim_mapa->first - ultima) {
+        paginas.erase(inicio_mapa);
+      } else {
+        paginas.erase(fim_mapa);
+      }
+    }
+
+    return lidas;
+  }
+
+  // Linha na posição index da ordenação atual, ou nullptr se a página não
+  // está carregada (ou a tabela mudou desde a contagem)
+  StockRow* At(int index) {
+    auto pagina = paginas.find(index / kPageSize);
+    if (pagina == paginas.end()) return nullptr;
+
+    const auto& linhas = pagina->second.linhas;
+    const size_t i = index % kPageSize;
+    return i < linhas.size() ? &pagina->second.linhas[i] : nullptr;
+  }
+
+  // Ids das linhas [inicio, fim) da ordenação atual, lidos do banco mesmo
+  // que as páginas delas não estejam carregadas. Usado pelas seleções de
+  // várias linhas, que podem ir além das páginas na memória
+  std::vector<int> Ids(int inicio, int fim) {
+    std::vector<int> ids;
+    if (inicio >= fim) return ids;
+
+    Bind(*faixa);
+    faixa->Bind(faixa->Parameter(":limite"), fim - inicio)
+        .Bind(faixa->Parameter(":pular"), inicio);
+
+    while (faixa->Step()) ids.push_back(faixa->ColumnInt(0));
+    faixa->Reset();
+
+    return ids;
+  }
+
+  // Aplica fn a cada linha das páginas carregadas
+  template <typename Fn>
+  void ForEachLoaded(Fn&& fn) {
+    for (auto& [numero, pagina] : paginas) {
+      for (StockRow& linha : pagina.linhas) fn(linha);
+    }
+  }
+
+ private:
+  // Valores da chave de ordenação de uma linha, terminada pelo id
+  struct Key {
+    int numero = 0;      // data ou código
+    std::string texto;   // nome do doador
+    int id_doador = 0;
+    int id = 0;
+  };
+
+  Key KeyOf(const StockRow& linha) const {
+    Key chave;
+    chave.id = linha.id;
+
+    switch (ordem) {
+      case StockSort::kData:
+        chave.numero = linha.data;
+        break;
+      case StockSort::kTamanho:
+        chave.numero = static_cast<int>(linha.tamanho);
+        break;
+      case StockSort::kCondicao:
+        chave.numero = static_cast<int>(linha.condicao);
+        break;
+      case StockSort::kDoador:
+        chave.texto = std::string(linha.doador);
+        chave.id_doador = linha.id_doador;
+        break;
+      case StockSort::kStatus:
+        chave.numero = static_cast<int>(linha.status);
+        break;
+    }
+
+    return chave;
+  }
+
+  // Monta as consultas para a ordenação e os filtros atuais
+  void Prepare() {
+    const char* colunas =
+        "SELECT doacao.id, doacao.data, doacao.tamanho, doacao.condicao,"
+        " doacao.status, doacao.descricao, doador.id, doador.nome ";
+    const std::string de = From(ordem);
+    const std::string onde = Where(filtro);
+
+    // Colunas da chave de ordenação e os parâmetros que recebem os valores
+    // dela, sempre terminadas pelo id para que a chave seja única
+    std::vector<const char*> chave;
+    std::string valores = ":chave, ";
+
+    switch (ordem) {
+      case StockSort::kData:
+        chave = {"doacao.data"};
+        break;
+      case StockSort::kTamanho:
+        chave = {"doacao.tamanho"};
+        break;
+      case StockSort::kCondicao:
+        chave = {"doacao.condicao"};
+        break;
+      case StockSort::kDoador:
+        chave = {"doador.nome", "doador.id"};
+        valores += ":chave_doador, ";
+        break;
+      case StockSort::kStatus:
+        chave = {"doacao.status"};
+        break;
+    }
+
+    chave.push_back("doacao.id");
+    valores += ":id";
+
+    std::string tupla;
+    for (const char* coluna : chave)
+      tupla += (tupla.empty() ? "" : ", ") + std::string(coluna);
+
+    auto ordenado = [&](bool asc) {
+      std::string sql;
+      for (const char* coluna : chave) {
+        sql += (sql.empty() ? " ORDER BY " : ", ") + std::string(coluna) +
+               (asc ? " ASC" : " DESC");
+      }
+
+      return sql + " LIMIT :limite";
+    };
+
+    const std::string depois = " AND (" + tupla + ") " +
+                               (crescente ? ">" : "<") + " (" + valores + ")";
+    const std::string antes = " AND (" + tupla + ") " +
+                              (crescente ? "<" : ">") + " (" + valores + ")";
+
+    pular = Make(colunas + de + onde + ordenado(crescente) + " OFFSET :pular");
+    seguinte = Make(colunas + de + onde + depois + ordenado(crescente));
+    anterior = Make(colunas + de + onde + antes + ordenado(!crescente));
+    faixa = Make("SELECT doacao.id " + de + onde + ordenado(crescente) +
+                 " OFFSET :pular");
+
+    preparado = true;
+  }
+
+  // Partes das consultas que dependem da ordenação e dos filtros. A junção
+  // com doador é a mesma nas duas ordens, então a contagem (que usa a
+  // primeira) deixa de fora as mesmas doações sem doador que as páginas.
+  // Ordenado pelo doador, o laço começa pela tabela doador para percorrer o
+  // índice do nome sem ordenar todas as doações
+  static const char* From(StockSort ordem) {
+    return ordem == StockSort::kDoador
+               ? "FROM doador CROSS JOIN doacao ON doacao.id_doador = doador.id"
+               : "FROM doacao JOIN doador ON doador.id = doacao.id_doador";
+  }
+
+  static std::string Where(const StockFilter& filtro) {
+    std::string onde = " WHERE 1";
+
+    // A busca não tem limite próprio: ela é combinada com os outros filtros,
+    // e um limite aplicado antes deles perderia doações que passam por todos.
+    // As páginas já limitam o que é lido de cada vez
+    if (!filtro.busca.empty()) {
+      onde +=
+          " AND doacao.id IN (SELECT rowid FROM doacao_fts"
+          " WHERE doacao_fts MATCH :busca)";
+    }
+
+    if (filtro.inicio) onde += " AND doacao.data >= :inicio";
+    if (filtro.fim) onde += " AND doacao.data <= :fim";
+    if (filtro.apenas_disponiveis) {
+      onde += " AND doacao.status != " +
+              std::to_string(static_cast<int>(Status::kDoado));
+    }
+
+    return onde;
+  }
+
+  // Quais filtros estão ativos, o que decide o texto de Where()
+  static int Shape(const StockFilter& filtro) {
+    return (filtro.busca.empty() ? 0 : 1) | (filtro.inicio ? 2 : 0) |
+           (filtro.fim ? 4 : 0) | (filtro.apenas_disponiveis ? 8 : 0);
+  }
+
+  std::unique_ptr<Statement> Make(const std::string& sql) {
+    return std::make_unique<Statement>(db, sql.c_str());
+  }
+
+  // Liga os parâmetros dos filtros que a consulta usa
+  static void BindFilter(Statement& statement, const StockFilter& filtro) {
+    if (int i = statement.Parameter(":busca"))
+      statement.BindCopy(i, Queries::Phrase(filtro.busca));
+    if (int i = statement.Parameter(":inicio"))
+      statement.Bind(i, filtro.inicio);
+    if (int i = statement.Parameter(":fim")) statement.Bind(i, filtro.fim);
+  }
+
+  void Bind(Statement& statement) {
+    BindFilter(statement, filtro);
+    if (int i = statement.Parameter(":limite")) statement.Bind(i, kPageSize);
+  }
+
+  void BindKey(Statement& statement, const Key& chave) {
+    const int i = statement.Parameter(":chave");
+
+    if (ordem == StockSort::kDoador) {
+      statement.BindCopy(i, chave.texto);
+    } else {
+      statement.Bind(i, chave.numero);
+    }
+
+    if (int doador = statement.Parameter(":chave_doador"))
+      statement.Bind(doador, chave.id_doador);
+    statement.Bind(statement.Parameter(":id"), chave.id);
+  }
+
+  // Linhas de uma página, com os textos de todas em um único StringPool,
+  // liberado junto com a página
+  struct Pagina {
+    std::vector<StockRow> linhas;
+    StringPool textos;
+  };
+
+  size_t LoadPage(int pagina) {
+    Pagina lida;
+
+    // A chave que antecede a página é conhecida se a página anterior já foi
+    // lida. Senão, a página seguinte permite ler para trás a partir dela
+    auto antecessora = chaves.find(pagina);
+    auto proxima = paginas.find(pagina + 1);
+
+    if (pagina == 0) {
+      Bind(*pular);
+      pular->Bind(pular->Parameter(":pular"), 0);
+      Read(*pular, lida);
+    } else if (antecessora != chaves.end()) {
+      Bind(*seguinte);
+      BindKey(*seguinte, antecessora->second);
+      Read(*seguinte, lida);
+    } else if (proxima != paginas.end() && !proxima->second.linhas.empty()) {
+      Bind(*anterior);
+      BindKey(*anterior, KeyOf(proxima->second.linhas.front()));
+      Read(*anterior, lida);
+      std::reverse(lida.linhas.begin(), lida.linhas.end());
+    } else {
+      Bind(*pular);
+      pular->Bind(pular->Parameter(":pular"), pagina * kPageSize);
+      Read(*pular, lida);
+    }
+
+    if (lida.linhas.size() == static_cast<size_t>(kPageSize))
+      chaves[pagina + 1] = KeyOf(lida.linhas.back());
+
+    const size_t lidas = lida.linhas.size();
+    paginas[pagina] = std::move(lida);
+
+    return lidas;
+  }
+
+  static void Read(Statement& statement, Pagina& pagina) {
+    pagina.linhas.reserve(kPageSize);
+
+    while (statement.Step()) {
+      pagina.linhas.push_back(StockRow{
+          statement.ColumnInt(0),
+          statement.ColumnInt(1),
+          static_cast<Tamanho>(statement.ColumnInt(2)),
+          static_cast<Condicao>(statement.ColumnInt(3)),
+          static_cast<Status>(statement.ColumnInt(4)),
+          pagina.textos.Add(statement.ColumnView(5)),
+          statement.ColumnInt(6),
+          pagina.textos.Add(statement.ColumnView(7)),
+      });
+    }
+
+    statement.Reset();
+  }
+
+  sqlite3* db;
+
+  StockSort ordem = StockSort::kData;
+  bool crescente = true;
+  StockFilter filtro;
+  bool preparado = false;
+  bool sujo = true;
+  unsigned geracao = 0;
+
+  std::unique_ptr<Statement> pular;
+  std::unique_ptr<Statement> seguinte;
+  std::unique_ptr<Statement> anterior;
+  std::unique_ptr<Statement> faixa;
+
+  int total = 0;
+
+  // Página -> linhas, só as próximas da área visível
+  std::map<int, Pagina> paginas;
+
+  // Página -> chave da última linha da página anterior
+  std::map<int, Key> chaves;
+};
@@ -0,0 +1,393 @@
+#pragma once
+
+#include <sqlite_orm/sqlite_orm.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "migrations.hpp"
+
+using namespace sqlite_orm;
+
+// Caminho padrão do banco de dados, relativo ao diretório de trabalho
+constexpr const char* kDatabasePath = "agasalhos.sqlite";
+
+struct Doador {
+  int id;
+  std::string nome;
+  std::string telefone;
+
+  // phoneKey() do telefone, que identifica o doador. É nula apenas nas
+  // linhas antigas, até a migração v6 preenchê-la
+  std::optional<long long> telefone_chave;
+};
+
+// Valores fixos de tamanho, condição e status, gravados no banco como o
+// inteiro do código. A ordem é a dos combos e a das ordenações do estoque
+enum class Tamanho : uint8_t { kP, kM, kG, kGG, kXG };
+enum class Condicao : uint8_t { kNovo, kSemiNovo, kUsado };
+enum class Status : uint8_t { kDisponivel, kDoado };
+
+// Nomes exibidos de cada código, na mesma ordem dos enums
+inline constexpr const char* kTamanhos[] = {"P", "M", "G", "GG", "XG"};
+inline constexpr const char* kCondicoes[] = {"Novo", "Semi-novo", "Usado"};
+inline constexpr const char* kStatus[] = {"Disponível", "Doado"};
+
+inline constexpr int kTamanhoCount = static_cast<int>(std::size(kTamanhos));
+inline constexpr int kCondicaoCount = static_cast<int>(std::size(kCondicoes));
+inline constexpr int kStatusCount = static_cast<int>(std::size(kStatus));
+
+// Indica se o código lido do banco está no dicionário do enum. Um banco
+// corrompido ou editado por fora pode ter qualquer inteiro nessas colunas
+template <typename Code, size_t N>
+bool validCode(Code code, const char* const (&)[N]) {
+  return static_cast<size_t>(code) < N;
+}
+
+// Nome do código, ou "?" se ele está fora do dicionário
+template <typename Code, size_t N>
+const char* codeName(Code code, const char* const (&nomes)[N]) {
+  return validCode(code, nomes) ? nomes[static_cast<size_t>(code)] : "?";
+}
+
+inline const char* codeName(Tamanho tamanho) {
+  return codeName(tamanho, kTamanhos);
+}
+
+inline const char* codeName(Condicao condicao) {
+  return codeName(condicao, kCondicoes);
+}
+
+inline const char* codeName(Status status) { return codeName(status, kStatus); }
+
+// Código cujo nome é igual ao texto, usado pela importação
+template <typename Code, size_t N>
+std::optional<Code> parseCode(const std::string& texto,
+                              const char* const (&nomes)[N]) {
+  for (size_t i = 0; i < N; i++) {
+    if (texto == nomes[i]) return static_cast<Code>(i);
+  }
+
+  return std::nullopt;
+}
+
+// Intervalo das datas AAAAMMDD válidas. Bancos antigos podem ter datas fora
+// dele (0, em geral), de textos malformados convertidos pela migração v2
+inline constexpr int kMinDate = 10000101;
+inline constexpr int kMaxDate = 99991231;
+
+struct Doacao {
+  int id;
+  int data;  // AAAAMMDD, para que possa ser ordenada e filtrada por intervalo
+  Tamanho tamanho;
+  Condicao condicao;
+  Status status;
+  std::string descricao;
+
+  // Por valor, sem alocação por linha, para que Doacao possa ser copiada e
+  // movida como um valor comum. Vazio quando a coluna é NULL
+  std::optional<int> id_doador;
+};
+
+// Cada banco é uma estação de coleta, identificada por um número sorteado na
+// primeira abertura. As outras estações aparecem aqui quando as alterações
+// delas são importadas, e relogio é o da última alteração aplicada de cada
+// uma (ou, na local, o da última registrada)
+struct Estacao {
+  long long id;
+  bool local;
+  int relogio;
+  int exportado;  // relógio da última alteração local exportada
+};
+
+enum class Operacao : uint8_t { kInserir, kStatus, kRemover };
+
+// Entrada do registro de alterações, que só recebe inserções. A alteração é
+// identificada pela estação que a fez e pelo relógio lógico dela, e aponta
+// a doação pela estação onde ela foi cadastrada (origem) e pelo id que ela
+// tem lá. Os dados da doação e do doador só são preenchidos em kInserir
+struct Alteracao {
+  int id;
+  long long estacao;
+  int relogio;
+  Operacao operacao;
+  long long origem;
+  int doacao;
+  int data;
+  Tamanho tamanho;
+  Condicao condicao;
+  Status status;
+  std::string descricao;
+  std::string nome;
+  std::string telefone;
+};
+
+// Doação recebida de outra estação: (origem, id na origem) -> id local
+struct Replica {
+  long long origem;
+  int doacao_origem;
+  int doacao;
+};
+
+// Rascunho do formulário de cadastro, com os campos como estavam sendo
+// digitados (ainda sem validar), para que não se percam se o aplicativo
+// fechar sem terminar o cadastro. A tabela tem no máximo uma linha, id 1
+struct Rascunho {
+  int id;
+  std::string nome;
+  std::string telefone;
+  std::string data;
+  Tamanho tamanho;
+  Condicao condicao;
+  std::string descricao;
+};
+
+// Leitura e gravação dos códigos pelo sqlite_orm, como colunas INTEGER
+template <typename Code>
+struct CodeBinder {
+  int bind(sqlite3_stmt* stmt, int index, const Code& valor) const {
+    return sqlite3_bind_int(stmt, index, static_cast<int>(valor));
+  }
+};
+
+template <typename Code>
+struct CodePrinter {
+  std::string operator()(const Code& valor) const {
+    return std::to_string(static_cast<int>(valor));
+  }
+};
+
+template <typename Code>
+struct CodeExtractor {
+  Code extract(const char* valor) const {
+    return static_cast<Code>(valor ? std::atoi(valor) : 0);
+  }
+
+  Code extract(sqlite3_stmt* stmt, int coluna) const {
+    return static_cast<Code>(sqlite3_column_int(stmt, coluna));
+  }
+
+  Code extract(sqlite3_value* valor) const {
+    return static_cast<Code>(sqlite3_value_int(valor));
+  }
+};
+
+namespace sqlite_orm {
+template <>
+struct type_printer<Tamanho> : integer_printer {};
+template <>
+struct statement_binder<Tamanho> : CodeBinder<Tamanho> {};
+template <>
+struct field_printer<Tamanho> : CodePrinter<Tamanho> {};
+template <>
+struct row_extractor<Tamanho> : CodeExtractor<Tamanho> {};
+
+template <>
+struct type_printer<Condicao> : integer_printer {};
+template <>
+struct statement_binder<Condicao> : CodeBinder<Condicao> {};
+template <>
+struct field_printer<Condicao> : CodePrinter<Condicao> {};
+template <>
+struct row_extractor<Condicao> : CodeExtractor<Condicao> {};
+
+template <>
+struct type_printer<Status> : integer_printer {};
+template <>
+struct statement_binder<Status> : CodeBinder<Status> {};
+template <>
+struct field_printer<Status> : CodePrinter<Status> {};
+template <>
+struct row_extractor<Status> : CodeExtractor<Status> {};
+
+template <>
+struct type_printer<Operacao> : integer_printer {};
+template <>
+struct statement_binder<Operacao> : CodeBinder<Operacao> {};
+template <>
+struct field_printer<Operacao> : CodePrinter<Operacao> {};
+template <>
+struct row_extractor<Operacao> : CodeExtractor<Operacao> {};
+}  // namespace sqlite_orm
+
+inline auto initStorage(const std::string& path) {
+  return make_storage(
+      path,
+
+      // Índices usados pela busca de doador por telefone, pela contagem de
+      // doações por doador e pelos filtros e ordenações do estoque
+      make_unique_index("idx_doador_telefone_chave", &Doador::telefone_chave),
+      make_index("idx_doador_nome", &Doador::nome),
+      make_index("idx_doacao_id_doador", &Doacao::id_doador),
+      make_index("idx_doacao_status", &Doacao::status),
+      make_index("idx_doacao_data", &Doacao::data),
+      make_index("idx_doacao_tamanho", &Doacao::tamanho),
+      make_index("idx_doacao_condicao", &Doacao::condicao),
+
+      // Alterações de cada estação em ordem, e o caminho inverso das doações
+      // replicadas, usado para registrar as alterações feitas nelas aqui
+      make_unique_index("idx_alteracao_relogio", &Alteracao::estacao,
+                        &Alteracao::relogio),
+      make_index("idx_replica_doacao", &Replica::doacao),
+
+      make_table("doador",
+                 make_column("id", &Doador::id, primary_key().autoincrement()),
+                 make_column("nome", &Doador::nome),
+                 make_column("telefone", &Doador::telefone),
+                 make_column("telefone_chave", &Doador::telefone_chave)),
+      make_table("doacao",
+                 make_column("id", &Doacao::id, primary_key().autoincrement()),
+                 make_column("data", &Doacao::data),
+                 make_column("tamanho", &Doacao::tamanho),
+                 make_column("condicao", &Doacao::condicao),
+                 make_column("status", &Doacao::status),
+                 make_column("descricao", &Doacao::descricao),
+                 make_column("id_doador", &Doacao::id_doador),
+                 foreign_key(&Doacao::id_doador).references(&Doador::id)),
+      make_table("estacao",
+                 make_column("id", &Estacao::id, primary_key()),
+                 make_column("local", &Estacao::local),
+                 make_column("relogio", &Estacao::relogio),
+                 make_column("exportado", &Estacao::exportado)),
+      make_table("alteracao",
+                 make_column("id", &Alteracao::id,
+                             primary_key().autoincrement()),
+                 make_column("estacao", &Alteracao::estacao),
+                 make_column("relogio", &Alteracao::relogio),
+                 make_column("operacao", &Alteracao::operacao),
+                 make_column("origem", &Alteracao::origem),
+                 make_column("doacao", &Alteracao::doacao),
+                 make_column("data", &Alteracao::data),
+                 make_column("tamanho", &Alteracao::tamanho),
+                 make_column("condicao", &Alteracao::condicao),
+                 make_column("status", &Alteracao::status),
+                 make_column("descricao", &Alteracao::descricao),
+                 make_column("nome", &Alteracao::nome),
+                 make_column("telefone", &Alteracao::telefone)),
+      make_table("replica",
+                 make_column("origem", &Replica::origem),
+                 make_column("doacao_origem", &Replica::doacao_origem),
+                 make_column("doacao", &Replica::doacao),
+                 primary_key(&Replica::origem, &Replica::doacao_origem)),
+      make_table("rascunho",
+                 make_column("id", &Rascunho::id, primary_key()),
+                 make_column("nome", &Rascunho::nome),
+                 make_column("telefone", &Rascunho::telefone),
+                 make_column("data", &Rascunho::data),
+                 make_column("tamanho", &Rascunho::tamanho),
+                 make_column("condicao", &Rascunho::condicao),
+                 make_column("descricao", &Rascunho::descricao)));
+};
+
+using Storage = decltype(initStorage(""));
+
+// Configuração aplicada a cada conexão com o banco. O padrão troca o journal
+// de rollback pelo WAL, que permite que a interface leia enquanto o thread de
+// escrita grava, e usa synchronous NORMAL, que no modo WAL só pode perder as
+// últimas transações em caso de queda de energia, nunca corromper o banco
+struct StorageProfile {
+  bool wal = true;
+
+  // 0 = OFF, 1 = NORMAL, 2 = FULL
+  int synchronous = 1;
+
+  // Tamanho do cache de páginas de cada conexão, em KiB
+  int cache_size_kib = 64 * 1024;
+
+  // Quanto do arquivo pode ser lido via mmap, em bytes
+  long long mmap_size = 256LL * 1024 * 1024;
+
+  // Quanto tempo esperar quando o banco está bloqueado por outra conexão
+  int busy_timeout_ms = 5000;
+
+  // Valores padrão do próprio SQLite, usados como comparação nos benchmarks
+  static StorageProfile SqliteDefaults() {
+    StorageProfile profile;
+    profile.wal = false;
+    profile.synchronous = 2;
+    profile.cache_size_kib = 2000;
+    profile.mmap_size = 0;
+
+    return profile;
+  }
+};
+
+inline void applyProfile(sqlite3* db, const StorageProfile& profile) {
+  sqlite3_busy_timeout(db, profile.busy_timeout_ms);
+
+  const std::string pragmas =
+      std::string("PRAGMA journal_mode = ") +
+      (profile.wal ? "WAL" : "DELETE") +
+      ";PRAGMA synchronous = " + std::to_string(profile.synchronous) +
+      ";PRAGMA cache_size = -" + std::to_string(profile.cache_size_kib) +
+      ";PRAGMA mmap_size = " + std::to_string(profile.mmap_size) +
+      ";PRAGMA temp_store = MEMORY;";
+
+  sqlite3_exec(db, pragmas.c_str(), nullptr, nullptr, nullptr);
+}
+
+// Mantém a conexão do storage aberta até ele ser destruído, em vez de abrir e
+// fechar o arquivo a cada chamada, e aplica o perfil a ela. Devolve o handle
+// da conexão, usado pelas consultas preparadas
+inline sqlite3* openForever(Storage& stor, const StorageProfile& profile) {
+  auto handle = std::make_shared<sqlite3*>(nullptr);
+
+  stor.on_open = [profile, handle](sqlite3* db) {
+    applyProfile(db, profile);
+    *handle = db;
+  };
+  stor.open_forever();
+
+  return *handle;
+}
+
+// Abre o banco, aplicando as migrações pendentes antes de devolvê-lo
+inline std::unique_ptr<Storage> openStorage(const std::string& path) {
+  // Migra bancos criados por versões anteriores sem perder os dados. Quando
+  // o PRAGMA user_version já é o atual, o sync_schema() é pulado: ele lê o
+  // esquema de cada tabela para compará-lo com o declarado, e pode recriá-las
+  Migrator migrator(path);
+  const bool atual = migrator.Current();
+  if (!atual) migrator.BeforeSync();
+
+  auto stor = std::make_unique<Storage>(initStorage(path));
+
+  if (!atual) {
+    stor->sync_schema();
+    migrator.AfterSync();
+  }
+
+  if (stor->count<Estacao>(where(c(&Estacao::local) == true)) == 0) {
+    std::random_device semente;
+    std::mt19937_64 rng((uint64_t(semente()) << 32) | semente());
+
+    stor->replace(Estacao{static_cast<long long>(rng() >> 1), true, 0, 0});
+  }
+
+  return stor;
+}
+
+// Estação deste banco
+inline Estacao localStation(Storage& stor) {
+  return stor.get_all<Estacao>(where(c(&Estacao::local) == true)).at(0);
+}
+
+// Total de doações por doador, calculado com uma única consulta agrupada
+inline std::unordered_map<int, int> countDonationsByDonor(Storage& stor) {
+  std::unordered_map<int, int> totais;
+
+  for (auto& [id_doador, total] :
+       stor.select(columns(&Doacao::id_doador, count(&Doacao::id)),
+                   group_by(&Doacao::id_doador))) {
+    if (id_doador) totais[*id_doador] = total;
+  }
+
+  return totais;
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "queries.hpp"
+#include "storage.hpp"
+
+// Thread dedicado às escritas no banco. Ele mantém a própria conexão aberta
+// durante toda a sessão e executa as tarefas na ordem em que foram
+// enfileiradas, para que o thread da interface nunca espere por um fsync.
+//
+// O resultado de cada tarefa volta para o thread da interface pelo callback
+// informado em Push(), executado dentro de DispatchCompletions(). O callback
+// recebe nullptr em caso de sucesso, ou a mensagem do erro. Se o banco não
+// pôde ser aberto, todas as tarefas falham com o erro da abertura.
+class StorageWorker {
+ public:
+  using Task = std::function<void(Storage&, Queries&)>;
+  using Done = std::function<void(const char* erro)>;
+
+  // notify é chamado (no thread do banco) sempre que uma tarefa termina
+  StorageWorker(const std::string& path, const StorageProfile& profile,
+                std::function<void()> notify)
+      : path(path),
+        profile(profile),
+        notify(std::move(notify)),
+        thread([this] { Run(); }) {}
+
+  // Termina as tarefas pendentes antes de fechar a conexão
+  ~StorageWorker() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+
+    wake.notify_one();
+    thread.join();
+  }
+
+  StorageWorker(const StorageWorker&) = delete;
+  StorageWorker& operator=(const StorageWorker&) = delete;
+
+  void Push(Task task, Done done = nullptr) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      tasks.push_back({std::move(task), std::move(done)});
+      pending++;
+    }
+
+    wake.notify_one();
+  }
+
+  // Executa os callbacks das tarefas concluídas. Deve ser chamado pelo thread
+  // da interface
+  void DispatchCompletions() {
+    std::vector<Completion> prontas;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      prontas.swap(completions);
+    }
+
+    for (Completion& completion : prontas) {
+      if (completion.done)
+        completion.done(completion.erro.empty() ? nullptr
+                                                : completion.erro.c_str());
+
+      std::lock_guard<std::mutex> lock(mutex);
+      pending--;
+    }
+  }
+
+  // Indica se não há tarefas na fila, em execução ou com callback pendente
+  bool Idle() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return pending == 0;
+  }
+
+ private:
+  struct Entry {
+    Task task;
+    Done done;
+  };
+
+  struct Completion {
+    Done done;
+    std::string erro;
+  };
+
+  void Run() {
+    std::unique_ptr<Storage> stor;
+    std::unique_ptr<Queries> queries;
+    std::string falha;
+
+    try {
+      stor = std::make_unique<Storage>(initStorage(path));
+      queries = std::make_unique<Queries>(openForever(*stor, profile));
+    } catch (const std::exception& e) {
+      falha = std::string("Não foi possível abrir o banco: ") + e.what();
+    }
+
+    for (;;) {
+      Entry entry;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [this] { return stopping || !tasks.empty(); });
+
+        if (tasks.empty()) return;
+
+        entry = std::move(tasks.front());
+        tasks.pop_front();
+      }
+
+      Completion completion{std::move(entry.done), falha};
+
+      if (falha.empty()) {
+        try {
+          entry.task(*stor, *queries);
+        } catch (const std::exception& e) {
+          completion.erro = e.what();
+        }
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        completions.push_back(std::move(completion));
+      }
+
+      if (notify) notify();
+    }
+  }
+
+  std::string path;
+  StorageProfile profile;
+  std::function<void()> notify;
+
+  mutable std::mutex mutex;
+  std::condition_variable wake;
+  std::deque<Entry> tasks;
+  std::vector<Completion> completions;
+  size_t pending = 0;
+  bool stopping = false;
+
+  // Declarado por último para que o thread só comece depois dos outros membros
+  std::thread thread;
+};
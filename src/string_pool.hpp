@@ -0,0 +1,83 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Área de memória para os textos das linhas lidas do banco. Os textos são
+// copiados um atrás do outro em blocos grandes, e as linhas guardam apenas
+// std::string_view para eles, em vez de um std::string alocado por campo.
+// Os blocos nunca se movem, então os textos continuam válidos enquanto o
+// pool existir (inclusive depois de movido), e toda a memória é liberada
+// de uma vez quando ele é limpo ou destruído.
+class StringPool {
+ public:
+  // Os blocos dobram de tamanho a cada um alocado, até kMaxBlockSize, para
+  // que tabelas pequenas usem pouca memória e grandes usem poucos blocos
+  static constexpr size_t kMinBlockSize = 4 * 1024;
+  static constexpr size_t kMaxBlockSize = 1024 * 1024;
+
+  StringPool() = default;
+
+  // O pool movido fica vazio, e não continua escrevendo nos blocos que agora
+  // pertencem ao outro
+  StringPool(StringPool&& outro) noexcept { *this = std::move(outro); }
+
+  StringPool& operator=(StringPool&& outro) noexcept {
+    if (this == &outro) return *this;
+
+    blocos = std::move(outro.blocos);
+    atual = outro.atual;
+    livre = outro.livre;
+    usados = outro.usados;
+    proximo = outro.proximo;
+    outro.Clear();
+
+    return *this;
+  }
+
+  std::string_view Add(std::string_view texto) {
+    if (texto.empty()) return std::string_view();
+    if (texto.size() > livre) Grow(texto.size());
+
+    char* destino = atual;
+    std::memcpy(destino, texto.data(), texto.size());
+    atual += texto.size();
+    livre -= texto.size();
+    usados += texto.size();
+
+    return std::string_view(destino, texto.size());
+  }
+
+  void Clear() {
+    blocos.clear();
+    atual = nullptr;
+    livre = 0;
+    usados = 0;
+    proximo = kMinBlockSize;
+  }
+
+  // Bytes de texto guardados, e quantos blocos foram alocados para eles
+  size_t Bytes() const { return usados; }
+  size_t Blocks() const { return blocos.size(); }
+
+ private:
+  void Grow(size_t minimo) {
+    // O espaço que sobrou no bloco atual é descartado
+    const size_t tamanho = std::max(proximo, minimo);
+    blocos.emplace_back(new char[tamanho]);
+
+    atual = blocos.back().get();
+    livre = tamanho;
+    proximo = std::min(proximo * 2, kMaxBlockSize);
+  }
+
+  std::vector<std::unique_ptr<char[]>> blocos;
+  char* atual = nullptr;
+  size_t livre = 0;
+  size_t usados = 0;
+  size_t proximo = kMinBlockSize;
+};